@@ -0,0 +1,276 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/plugin.hpp"
+
+
+void init(Plugin* p);
+
+
+namespace harness {
+
+inline Plugin& plugin() {
+	static Plugin p;
+	static bool initialized = false;
+	if (!initialized) {
+		init(&p);
+		initialized = true;
+	}
+	return p;
+}
+
+template <typename TInfo>
+int findPort(const std::vector<TInfo*>& infos, const std::string& name, const char* kind) {
+	for (size_t i = 0; i < infos.size(); i++) {
+		if (infos[i] && infos[i]->name == name)
+			return static_cast<int>(i);
+	}
+	std::fprintf(stderr, "harness: no %s named \"%s\"\n", kind, name.c_str());
+	std::exit(1);
+}
+
+inline Input& input(Module* module, const std::string& name) {
+	return module->inputs[findPort(module->inputInfos, name, "input")];
+}
+
+inline Output& output(Module* module, const std::string& name) {
+	return module->outputs[findPort(module->outputInfos, name, "output")];
+}
+
+inline Param& param(Module* module, const std::string& name) {
+	return module->params[findPort(module->paramQuantities, name, "param")];
+}
+
+// Marks an input as patched and drives it with a mono voltage.
+inline void drive(Module* module, const std::string& name, float voltage) {
+	Input& in = input(module, name);
+	in.channels = 1;
+	in.setVoltage(voltage);
+}
+
+
+// Switches an Omen between same-sample delivery and passing messages one module
+// per frame, the way a saved patch would.
+inline void setSameSampleDelivery(Module* omen, const bool sameSample) {
+	json_t* rootJ = json_object();
+	json_object_set_new(rootJ, "sameSampleDelivery", json_boolean(sameSample));
+	omen->dataFromJson(rootJ);
+	json_decref(rootJ);
+}
+
+
+// A row of modules placed side by side, stepped the way Rack's engine does it:
+// expander messages are flipped at the start of every frame, then every module
+// is processed once, left to right.
+struct Rack {
+	std::vector<Module*> modules;
+	float sampleRate = 48000.f;
+	int64_t frame = 0;
+
+	Rack() = default;
+	Rack(const Rack&) = delete;
+	Rack& operator=(const Rack&) = delete;
+
+	~Rack() {
+		for (Module* module : modules)
+			delete module;
+	}
+
+	Module* add(const std::string& slug) {
+		Model* model = plugin().getModel(slug);
+		if (!model) {
+			std::fprintf(stderr, "harness: unknown module \"%s\"\n", slug.c_str());
+			std::exit(1);
+		}
+
+		Module* module = model->createModule();
+		module->model = model;
+		module->id = static_cast<int64_t>(modules.size()) + 1;
+		for (Output& out : module->outputs)
+			out.channels = 1;
+
+		modules.push_back(module);
+		link();
+		return module;
+	}
+
+	void link() {
+		for (size_t i = 0; i < modules.size(); i++) {
+			Module* left = i > 0 ? modules[i - 1] : nullptr;
+			Module* right = i + 1 < modules.size() ? modules[i + 1] : nullptr;
+			setExpander(modules[i], modules[i]->leftExpander, left, 0);
+			setExpander(modules[i], modules[i]->rightExpander, right, 1);
+		}
+	}
+
+	void step() {
+		for (Module* module : modules) {
+			flip(module->leftExpander);
+			flip(module->rightExpander);
+		}
+
+		Module::ProcessArgs args;
+		args.sampleRate = sampleRate;
+		args.sampleTime = 1.f / sampleRate;
+		args.frame = frame;
+
+		for (Module* module : modules) {
+			if (module->isBypassed())
+				module->processBypass(args);
+			else
+				module->process(args);
+		}
+
+		frame++;
+	}
+
+private:
+	static void setExpander(Module* module, Module::Expander& expander, Module* neighbor, const uint8_t side) {
+		if (expander.module == neighbor)
+			return;
+
+		expander.module = neighbor;
+		expander.moduleId = neighbor ? neighbor->id : -1;
+
+		Module::ExpanderChangeEvent e;
+		e.side = side;
+		module->onExpanderChange(e);
+	}
+
+	static void flip(Module::Expander& expander) {
+		if (!expander.messageFlipRequested)
+			return;
+		std::swap(expander.producerMessage, expander.consumerMessage);
+		expander.messageFlipRequested = false;
+	}
+};
+
+
+// 24ppqn clock with a reset pulse every few bars, rendered as trigger voltages.
+struct ClockScript {
+	float sampleRate = 48000.f;
+	float bpm = 120.f;
+	int barsPerReset = 4;
+
+	int64_t samplesPerTick() const {
+		return static_cast<int64_t>(sampleRate * 60.f / (bpm * 24.f));
+	}
+
+	int64_t tickAt(const int64_t frame) const {
+		return frame / samplesPerTick();
+	}
+
+	bool isTickStart(const int64_t frame) const {
+		return frame % samplesPerTick() == 0;
+	}
+
+	float clock(const int64_t frame) const {
+		return frame % samplesPerTick() < samplesPerTick() / 2 ? 10.f : 0.f;
+	}
+
+	float reset(const int64_t frame) const {
+		const int64_t samplesPerReset = samplesPerTick() * 96 * barsPerReset;
+		return frame > 0 && frame % samplesPerReset < 48 ? 10.f : 0.f;
+	}
+
+	// Gate following every nth tick, e.g. n = 6 for sixteenth notes.
+	float gate(const int64_t frame, const int n) const {
+		return tickAt(frame) % n == 0 ? clock(frame) : 0.f;
+	}
+
+	float lfo(const int64_t frame, const float hz) const {
+		return 5.f * std::sin(2.f * static_cast<float>(M_PI) * hz * static_cast<float>(frame) / sampleRate);
+	}
+};
+
+
+// Feeds the scripted clock, reset and CV streams into every module of the rack.
+// Ports are looked up once, so driving them costs next to nothing per frame.
+struct Patch {
+	enum Signal { CLOCK, RESET, LFO, GATE };
+
+	struct Cable {
+		Input* input;
+		Signal signal;
+		float arg;
+	};
+
+	std::vector<Cable> cables;
+
+	Patch(Rack& rack) {
+		for (size_t i = 0; i < rack.modules.size(); i++) {
+			Module* module = rack.modules[i];
+			const std::string& slug = module->model->slug;
+			const float lane = static_cast<float>(i);
+
+			if (slug == "Omen") {
+				connect(module, "Clock (24ppqn)", CLOCK, 0.f);
+				connect(module, "Reset", RESET, 0.f);
+			} else if (slug == "Kron") {
+				connect(module, "Density", LFO, 0.1f + 0.01f * lane);
+			} else if (slug == "Tale") {
+				connect(module, "Pace", LFO, 0.05f + 0.01f * lane);
+			} else if (slug == "Fate" || slug == "Lachesis") {
+				connect(module, "In", GATE, 6.f);
+			} else if (slug == "Moira") {
+				connect(module, "Trigger", GATE, 24.f);
+			} else if (slug == "Horae") {
+				for (int lane = 1; lane <= 8; lane++)
+					connect(module, "Lane " + std::to_string(lane) + " density", LFO, 0.1f + 0.01f * (lane + 8 * i));
+			}
+		}
+	}
+
+	void connect(Module* module, const std::string& name, const Signal signal, const float arg) {
+		Input& in = input(module, name);
+		in.channels = 1;
+		cables.push_back({&in, signal, arg});
+	}
+
+	void process(const ClockScript& script, const int64_t frame) const {
+		for (const Cable& cable : cables) {
+			switch (cable.signal) {
+			case CLOCK:
+				cable.input->setVoltage(script.clock(frame));
+				break;
+			case RESET:
+				cable.input->setVoltage(script.reset(frame));
+				break;
+			case LFO:
+				cable.input->setVoltage(script.lfo(frame, cable.arg));
+				break;
+			case GATE:
+				cable.input->setVoltage(script.gate(frame, static_cast<int>(cable.arg)));
+				break;
+			}
+		}
+	}
+};
+
+
+using Clock = std::chrono::steady_clock;
+
+inline double nsPerFrame(Rack& rack, const ClockScript& script, const int64_t frames) {
+	const Patch patch(rack);
+
+	for (int64_t i = 0; i < frames / 10; i++) {
+		patch.process(script, rack.frame);
+		rack.step();
+	}
+
+	const auto start = Clock::now();
+	for (int64_t i = 0; i < frames; i++) {
+		patch.process(script, rack.frame);
+		rack.step();
+	}
+	const auto end = Clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(frames);
+}
+
+} // namespace harness
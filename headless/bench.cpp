@@ -0,0 +1,76 @@
+// Headless throughput benchmark for the Tyche modules.
+//
+// Every measurement runs a row headed by Omen, fed by the scripted 24ppqn clock,
+// periodic reset and slow CV sweeps from Harness.hpp, and reports wall time per
+// engine frame. Per-module figures are the cost of a row of identical modules
+// minus the cost of Omen alone, divided by the row length. Chain length figures
+// are given for same-sample delivery and for messages passed one hop per frame.
+// The rhythm section compares eight Krons with one eight-lane Horae.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Harness.hpp"
+
+
+using namespace harness;
+
+static const char* MEMBERS[] = {"Kron", "Tale", "Fate", "Moira", "Blank"};
+
+
+static double measureRow(const std::vector<std::string>& slugs, const int64_t frames, const bool sameSample = true) {
+	Rack rack;
+	ClockScript script;
+	script.sampleRate = rack.sampleRate;
+
+	setSameSampleDelivery(rack.add("Omen"), sameSample);
+	for (const std::string& slug : slugs)
+		rack.add(slug);
+
+	return nsPerFrame(rack, script, frames);
+}
+
+
+int main(int argc, char** argv) {
+	int64_t frames = 48000 * 4;
+	int rowLength = 32;
+
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "--frames") && i + 1 < argc)
+			frames = std::atoll(argv[++i]);
+		else if (!std::strcmp(argv[i], "--row") && i + 1 < argc)
+			rowLength = std::atoi(argv[++i]);
+	}
+
+	const double omenOnly = measureRow({}, frames);
+
+	std::printf("# per module (row of %d behind Omen, %lld frames)\n", rowLength, static_cast<long long>(frames));
+	std::printf("%-8s %12s\n", "module", "ns/sample");
+	std::printf("%-8s %12.2f\n", "Omen", omenOnly);
+	for (const char* slug : MEMBERS) {
+		const std::vector<std::string> row(rowLength, slug);
+		const double total = measureRow(row, frames);
+		std::printf("%-8s %12.2f\n", slug, (total - omenOnly) / rowLength);
+	}
+
+	std::printf("\n# per chain length (Omen followed by Kron, Tale, Fate, Moira, Blank repeating)\n");
+	std::printf("%-8s %12s %12s %12s %12s\n", "length", "ns/sample", "ns/module", "hop ns/smp", "hop ns/mod");
+	for (int length = 1; length <= 64; length *= 2) {
+		std::vector<std::string> row;
+		for (int i = 0; i < length; i++)
+			row.emplace_back(MEMBERS[i % 5]);
+
+		const double total = measureRow(row, frames);
+		const double hopTotal = measureRow(row, frames, false);
+		std::printf("%-8d %12.2f %12.2f %12.2f %12.2f\n", length, total, total / (length + 1), hopTotal, hopTotal / (length + 1));
+	}
+
+	std::printf("\n# rhythm section (eight Krons or one Horae behind Omen)\n");
+	std::printf("%-8s %12s\n", "modules", "ns/sample");
+	std::printf("%-8s %12.2f\n", "8x Kron", measureRow(std::vector<std::string>(8, "Kron"), frames) - omenOnly);
+	std::printf("%-8s %12.2f\n", "Horae", measureRow({"Horae"}, frames) - omenOnly);
+
+	return 0;
+}
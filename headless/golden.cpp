@@ -0,0 +1,526 @@
+// Golden-output determinism suite for the Tyche modules.
+//
+// Every scenario builds a row headed by Omen and drives it with a fixed seed,
+// variant, clock, reset and CV script. Every output of every module is a
+// stream, compared against the checked-in golden/<scenario>.txt:
+//
+//   make -C headless golden            check all scenarios
+//   make -C headless golden-update     rewrite the golden files
+//   build/golden [--dir DIR] [--update] [SCENARIO...]
+//
+// A golden file holds, per stream, an FNV-1a hash over the bits of every
+// channel of every frame, and the frames on which the stream's channel count
+// or values changed. Streams that change on every frame, like Tale's, are only
+// recorded every `stride` frames to keep the files small; their hash still
+// covers every frame. A check fails on the first recorded frame where a stream
+// is off by more than its tolerance and reports that frame, the channel and
+// both values. Streams with no tolerance must also match their hash, which
+// catches differences between the recorded frames of a strided stream.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Harness.hpp"
+
+
+using namespace harness;
+
+
+// One output of one module, as recorded or checked.
+struct Stream {
+	std::string name;
+	Output* output = nullptr;
+	// Values are recorded and checked on every stride-th frame only.
+	int stride = 1;
+	// Largest difference in volts that still counts as a match; 0 is bit-exact.
+	float tolerance = 0.f;
+
+	uint64_t hash = 14695981039346656037ULL;
+
+	struct Frame {
+		int64_t frame = 0;
+		int channels = 0;
+		float values[PORT_MAX_CHANNELS] = {};
+	};
+	// Recorded changes; on check, those read from the golden file.
+	std::vector<Frame> changes;
+	size_t cursor = 0;
+
+	void hashFrame() {
+		const int channels = output->channels;
+		for (int c = 0; c < std::max(1, channels); c++) {
+			uint32_t bits;
+			std::memcpy(&bits, &output->voltages[c], sizeof(bits));
+			hash = (hash ^ bits) * 1099511628211ULL;
+		}
+		hash = (hash ^ static_cast<uint32_t>(channels)) * 1099511628211ULL;
+	}
+
+	Frame current(const int64_t frame) const {
+		Frame f;
+		f.frame = frame;
+		f.channels = output->channels;
+		for (int c = 0; c < std::max(1, f.channels); c++)
+			f.values[c] = output->voltages[c];
+		return f;
+	}
+
+	void record(const int64_t frame) {
+		const Frame f = current(frame);
+		if (!changes.empty()) {
+			const Frame& last = changes.back();
+			if (last.channels == f.channels && !std::memcmp(last.values, f.values, sizeof(f.values)))
+				return;
+		}
+		changes.push_back(f);
+	}
+
+	// Compares the stream on this frame with the golden one. Fills in `report`
+	// and returns false on the first mismatch.
+	bool check(const int64_t frame, std::string& report) {
+		while (cursor + 1 < changes.size() && changes[cursor + 1].frame <= frame)
+			cursor++;
+		if (changes.empty() || changes[cursor].frame > frame) {
+			report = "no golden value";
+			return false;
+		}
+
+		const Frame& expected = changes[cursor];
+		const Frame actual = current(frame);
+		char buffer[256];
+		if (actual.channels != expected.channels) {
+			std::snprintf(buffer, sizeof(buffer), "%d channels, expected %d", actual.channels, expected.channels);
+			report = buffer;
+			return false;
+		}
+
+		for (int c = 0; c < std::max(1, actual.channels); c++) {
+			const float difference = std::fabs(actual.values[c] - expected.values[c]);
+			const bool matches = tolerance > 0.f ? difference <= tolerance : !std::memcmp(&actual.values[c], &expected.values[c], sizeof(float));
+			if (!matches) {
+				std::snprintf(buffer, sizeof(buffer), "channel %d is %.9g, expected %.9g (off by %.3g V, tolerance %.3g V)",
+					c, actual.values[c], expected.values[c], difference, tolerance);
+				report = buffer;
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+
+// A row of modules with its own script on top of the Patch defaults.
+struct Scenario {
+	const char* name;
+	int64_t frames;
+	// Adds the modules to the rack and sets them up. Returns what has to be
+	// driven on every frame beyond the Patch defaults, if anything.
+	std::function<std::function<void(int64_t)>(Rack&, const ClockScript&)> build;
+};
+
+
+static void setJson(Module* module, const char* key, json_t* valueJ) {
+	json_t* rootJ = json_object();
+	json_object_set_new(rootJ, key, valueJ);
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+}
+
+static json_t* intArray(const std::vector<int>& values) {
+	json_t* arrayJ = json_array();
+	for (const int value : values)
+		json_array_append_new(arrayJ, json_integer(value));
+	return arrayJ;
+}
+
+// Sets Omen's seed the way its buttons would, one state (0 to 5) per button.
+static void setSeed(Module* omen, const std::vector<int>& states) {
+	int seed = 0;
+	for (size_t i = 0; i < states.size(); i++)
+		seed ^= (states[i] + 1) << (i * 3);
+
+	json_t* rootJ = json_object();
+	json_object_set_new(rootJ, "seed", json_integer(seed));
+	json_object_set_new(rootJ, "seedConfiguration", intArray(states));
+	omen->dataFromJson(rootJ);
+	json_decref(rootJ);
+}
+
+// Drives one channel of a poly input. The channel count is set on every frame
+// since Patch connects some of these inputs as mono.
+static void drivePoly(Input& in, const int channels, const int c, const float voltage) {
+	in.channels = channels;
+	in.setVoltage(voltage, c);
+}
+
+
+// 240 BPM puts a bar in exactly one second at 48 kHz.
+static ClockScript makeScript() {
+	ClockScript script;
+	script.bpm = 240.f;
+	script.barsPerReset = 2;
+	return script;
+}
+
+
+static std::vector<Scenario> scenarios() {
+	return {
+		// The modules of the original release, with messages passed one module
+		// per frame as in patches saved before same-sample delivery, re-seeded
+		// halfway through by pressing Alpha.
+		{"chain-hop", 48000 * 3, [](Rack& rack, const ClockScript& script) -> std::function<void(int64_t)> {
+			Module* omen = rack.add("Omen");
+			setSameSampleDelivery(omen, false);
+			for (const char* slug : {"Kron", "Tale", "Fate", "Moira", "Kron", "Moira", "Fate", "Blank", "Tale"})
+				rack.add(slug);
+
+			Module* moira = rack.modules[6];
+			param(moira, "Fade duration").setValue(0.01f);
+			param(moira, "X").setValue(3.f);
+			param(moira, "Y").setValue(-2.f);
+			param(rack.modules[5], "Density").setValue(80.f);
+			param(rack.modules[9], "Variant").setValue(7.f);
+
+			Module* kron = rack.modules[5];
+			Module* fate = rack.modules[7];
+			Input& moiraY = input(moira, "Y");
+			return [=, &moiraY, &script](const int64_t frame) {
+				param(omen, "Alpha").setValue(frame >= 72000 && frame < 72048 ? 1.f : 0.f);
+				drivePoly(moiraY, 2, 0, script.lfo(frame, 0.3f));
+				drivePoly(moiraY, 2, 1, script.lfo(frame, 0.7f));
+				drive(kron, "Mute", script.gate(frame, 48));
+				drive(fate, "Bias", script.lfo(frame, 0.2f));
+			};
+		}},
+
+		// Same-sample delivery with another seed, re-seeded halfway through by
+		// pressing Alpha, and other variants.
+		{"chain-same-sample", 48000 * 3, [](Rack& rack, const ClockScript& script) -> std::function<void(int64_t)> {
+			Module* omen = rack.add("Omen");
+			setSameSampleDelivery(omen, true);
+			setSeed(omen, {2, 0, 5, 1, 3, 4});
+			for (const char* slug : {"Kron", "Fate", "Tale", "Moira", "Kron", "Lachesis"})
+				rack.add(slug);
+
+			param(rack.modules[1], "Variant").setValue(12.f);
+			setJson(rack.modules[1], "divisionIdx", json_integer(9));
+			param(rack.modules[2], "Variant").setValue(3.f);
+			param(rack.modules[2], "Bias").setValue(30.f);
+			param(rack.modules[3], "Variant").setValue(64.f);
+			param(rack.modules[4], "Variant").setValue(5.f);
+			param(rack.modules[4], "Z Relative probability").setValue(20.f);
+			param(rack.modules[4], "Z").setValue(-4.f);
+			setJson(rack.modules[5], "divisionIdx", json_integer(4));
+			setJson(rack.modules[6], "latch", json_true());
+
+			Module* tale = rack.modules[3];
+			return [=, &script](const int64_t frame) {
+				param(omen, "Alpha").setValue(frame >= 72000 && frame < 72048 ? 1.f : 0.f);
+				drive(tale, "S&H", script.gate(frame, 12));
+			};
+		}},
+
+		// The poly modes: Kron's division channels, four-channel Fate and
+		// Tale, and Moira fading between poly values. Moira's poly triggers
+		// have a scenario of their own.
+		{"poly", 48000 * 2, [](Rack& rack, const ClockScript& script) -> std::function<void(int64_t)> {
+			setSameSampleDelivery(rack.add("Omen"), true);
+			for (const char* slug : {"Kron", "Fate", "Tale", "Moira"})
+				rack.add(slug);
+
+			setJson(rack.modules[1], "polyMode", json_true());
+			setJson(rack.modules[1], "polyDivisions", json_integer(0x2d9));
+			param(rack.modules[4], "Fade duration").setValue(0.005f);
+			param(rack.modules[4], "X").setValue(1.f);
+			param(rack.modules[4], "Y").setValue(2.f);
+			param(rack.modules[4], "Z").setValue(3.f);
+
+			Input& fateIn = input(rack.modules[2], "In");
+			Input& talePace = input(rack.modules[3], "Pace");
+			Input& moiraY = input(rack.modules[4], "Y");
+			return [&fateIn, &talePace, &moiraY, &script](const int64_t frame) {
+				for (int c = 0; c < 4; c++) {
+					drivePoly(fateIn, 4, c, script.gate(frame, 3 + c));
+					drivePoly(talePace, 4, c, script.lfo(frame, 0.1f * (c + 1)));
+					drivePoly(moiraY, 4, c, script.lfo(frame, 0.15f * (c + 1)));
+				}
+			};
+		}},
+
+		// Moira's poly trigger mode with mono CVs on some value inputs, which
+		// every triggered channel has to read, as in a chord voicing patch.
+		{"moira-poly-trigger", 48000 * 2, [](Rack& rack, const ClockScript& script) -> std::function<void(int64_t)> {
+			setSameSampleDelivery(rack.add("Omen"), true);
+			rack.add("Moira");
+			rack.add("Clotho");
+
+			Module* moira = rack.modules[1];
+			setJson(moira, "polyTriggers", json_true());
+			param(moira, "Fade duration").setValue(0.005f);
+			param(moira, "X").setValue(10.f);
+			param(moira, "Y").setValue(5.f);
+			param(moira, "Z").setValue(-3.f);
+			param(rack.modules[2], "U Relative probability").setValue(40.f);
+			param(rack.modules[2], "U").setValue(10.f);
+
+			Input& trigger = input(moira, "Trigger");
+			Input& x = input(moira, "X");
+			Input& y = input(moira, "Y");
+			Input& u = input(rack.modules[2], "U");
+			return [&trigger, &x, &y, &u, &script](const int64_t frame) {
+				for (int c = 0; c < 6; c++) {
+					drivePoly(trigger, 6, c, script.gate(frame, 3 + 2 * c));
+					drivePoly(y, 6, c, script.lfo(frame, 0.2f * (c + 1)));
+				}
+				drivePoly(x, 1, 0, script.lfo(frame, 0.3f));
+				drivePoly(u, 1, 0, script.lfo(frame, 0.7f));
+			};
+		}},
+
+		// Horae with divisions and mutes across lanes, and a weighted Lachesis.
+		{"horae-lachesis", 48000 * 3, [](Rack& rack, const ClockScript& script) -> std::function<void(int64_t)> {
+			setSameSampleDelivery(rack.add("Omen"), true);
+			rack.add("Horae");
+			rack.add("Lachesis");
+
+			Module* horae = rack.modules[1];
+			setJson(horae, "divisionIdx", intArray({3, 6, 9, 6, 4, 10, 0, 9}));
+			setJson(horae, "muteSourceIdx", intArray({-1, 0, 1, 0, -1, 4, -1, 5}));
+
+			const float weights[8] = {10.f, 0.f, 30.f, 80.f, 5.f, 50.f, 0.f, 100.f};
+			for (int i = 0; i < 8; i++)
+				param(rack.modules[2], std::to_string(i + 1) + " relative weight").setValue(weights[i]);
+
+			Module* lachesis = rack.modules[2];
+			return [=, &script](const int64_t frame) {
+				drive(lachesis, "2 weight", script.lfo(frame, 0.5f));
+			};
+		}},
+	};
+}
+
+
+static std::string goldenPath(const std::string& dir, const Scenario& scenario) {
+	return dir + "/" + scenario.name + ".txt";
+}
+
+// Tale's output changes on every frame and Moira's while it fades; everything
+// else only on events.
+static int streamStride(const std::string& slug) {
+	if (slug == "Tale")
+		return 128;
+	if (slug == "Moira")
+		return 16;
+	return 1;
+}
+
+static float streamTolerance(const std::string& slug) {
+	return 0.f;
+}
+
+
+static std::vector<Stream> makeStreams(Rack& rack) {
+	std::vector<Stream> streams;
+	for (size_t i = 0; i < rack.modules.size(); i++) {
+		Module* module = rack.modules[i];
+		const std::string& slug = module->model->slug;
+		for (size_t o = 0; o < module->outputs.size(); o++) {
+			Stream stream;
+			stream.name = slug + std::to_string(i) + "." + module->outputInfos[o]->name;
+			// Output names may contain spaces; the files separate fields by them.
+			std::replace(stream.name.begin(), stream.name.end(), ' ', '_');
+			stream.output = &module->outputs[o];
+			stream.stride = streamStride(slug);
+			stream.tolerance = streamTolerance(slug);
+			streams.push_back(stream);
+		}
+	}
+	return streams;
+}
+
+
+static bool writeGolden(const std::string& path, const Scenario& scenario, const std::vector<Stream>& streams) {
+	FILE* file = std::fopen(path.c_str(), "w");
+	if (!file) {
+		std::fprintf(stderr, "golden: cannot write %s\n", path.c_str());
+		return false;
+	}
+
+	std::fprintf(file, "# Tyche golden output: scenario %s, %lld frames\n", scenario.name, static_cast<long long>(scenario.frames));
+	std::fprintf(file, "# stream <name> <stride> <hash>, then <frame> <channels> <values> on every change\n");
+	for (const Stream& stream : streams) {
+		std::fprintf(file, "stream %s %d %016" PRIx64 "\n", stream.name.c_str(), stream.stride, stream.hash);
+		for (const Stream::Frame& f : stream.changes) {
+			std::fprintf(file, "%lld %d", static_cast<long long>(f.frame), f.channels);
+			for (int c = 0; c < std::max(1, f.channels); c++)
+				std::fprintf(file, " %.9g", f.values[c]);
+			std::fprintf(file, "\n");
+		}
+	}
+
+	std::fclose(file);
+	return true;
+}
+
+
+struct GoldenStream {
+	std::string name;
+	int stride = 1;
+	uint64_t hash = 0;
+	std::vector<Stream::Frame> changes;
+};
+
+static bool readGolden(const std::string& path, std::vector<GoldenStream>& golden) {
+	FILE* file = std::fopen(path.c_str(), "r");
+	if (!file)
+		return false;
+
+	char line[4096];
+	while (std::fgets(line, sizeof(line), file)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if (!std::strncmp(line, "stream ", 7)) {
+			char name[256];
+			GoldenStream stream;
+			if (std::sscanf(line + 7, "%255s %d %" SCNx64, name, &stream.stride, &stream.hash) == 3) {
+				stream.name = name;
+				golden.push_back(stream);
+			}
+			continue;
+		}
+
+		if (golden.empty())
+			continue;
+
+		Stream::Frame f;
+		char* cursor = line;
+		f.frame = std::strtoll(cursor, &cursor, 10);
+		f.channels = static_cast<int>(std::strtol(cursor, &cursor, 10));
+		for (int c = 0; c < std::max(1, std::min(f.channels, PORT_MAX_CHANNELS)); c++)
+			f.values[c] = std::strtof(cursor, &cursor);
+		golden.back().changes.push_back(f);
+	}
+
+	std::fclose(file);
+	return true;
+}
+
+
+// Runs one scenario, recording or checking it. Returns false on failure.
+static bool run(const Scenario& scenario, const std::string& dir, const bool update) {
+	Rack rack;
+	const ClockScript script = makeScript();
+	rack.sampleRate = script.sampleRate;
+
+	const std::function<void(int64_t)> drive = scenario.build(rack, script);
+	const Patch patch(rack);
+	std::vector<Stream> streams = makeStreams(rack);
+
+	const std::string path = goldenPath(dir, scenario);
+	if (!update) {
+		std::vector<GoldenStream> golden;
+		if (!readGolden(path, golden)) {
+			std::printf("FAIL %-20s no golden file %s\n", scenario.name, path.c_str());
+			return false;
+		}
+		if (golden.size() != streams.size()) {
+			std::printf("FAIL %-20s %zu streams, golden file has %zu\n", scenario.name, streams.size(), golden.size());
+			return false;
+		}
+		for (size_t i = 0; i < streams.size(); i++) {
+			if (golden[i].name != streams[i].name || golden[i].stride != streams[i].stride) {
+				std::printf("FAIL %-20s stream %s does not match golden stream %s\n", scenario.name, streams[i].name.c_str(), golden[i].name.c_str());
+				return false;
+			}
+			streams[i].changes = golden[i].changes;
+		}
+
+		for (int64_t frame = 0; frame < scenario.frames; frame++) {
+			patch.process(script, rack.frame);
+			if (drive)
+				drive(frame);
+			rack.step();
+
+			for (Stream& stream : streams) {
+				stream.hashFrame();
+				std::string report;
+				if (frame % stream.stride == 0 && !stream.check(frame, report)) {
+					std::printf("FAIL %-20s %s first diverges at frame %lld (%.4f s): %s\n", scenario.name, stream.name.c_str(),
+						static_cast<long long>(frame), frame / script.sampleRate, report.c_str());
+					return false;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < streams.size(); i++) {
+			if (streams[i].tolerance == 0.f && streams[i].hash != golden[i].hash) {
+				std::printf("FAIL %-20s %s matches on every recorded frame, but its hash over all frames differs\n", scenario.name, streams[i].name.c_str());
+				return false;
+			}
+		}
+
+		std::printf("ok   %-20s %zu streams, %lld frames\n", scenario.name, streams.size(), static_cast<long long>(scenario.frames));
+		return true;
+	}
+
+	for (int64_t frame = 0; frame < scenario.frames; frame++) {
+		patch.process(script, rack.frame);
+		if (drive)
+			drive(frame);
+		rack.step();
+
+		for (Stream& stream : streams) {
+			stream.hashFrame();
+			if (frame % stream.stride == 0)
+				stream.record(frame);
+		}
+	}
+
+	if (!writeGolden(path, scenario, streams))
+		return false;
+	std::printf("wrote %s\n", path.c_str());
+	return true;
+}
+
+
+int main(int argc, char** argv) {
+	std::string dir = "golden";
+	bool update = false;
+	std::vector<std::string> selected;
+
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "--update"))
+			update = true;
+		else if (!std::strcmp(argv[i], "--dir") && i + 1 < argc)
+			dir = argv[++i];
+		else
+			selected.emplace_back(argv[i]);
+	}
+
+	int failures = 0;
+	int count = 0;
+	for (const Scenario& scenario : scenarios()) {
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), scenario.name) == selected.end())
+			continue;
+
+		count++;
+		if (!run(scenario, dir, update))
+			failures++;
+	}
+
+	if (count == 0) {
+		std::fprintf(stderr, "golden: no such scenario\n");
+		return 2;
+	}
+
+	if (!update)
+		std::printf("%d of %d scenarios passed\n", count - failures, count);
+	return failures ? 1 : 0;
+}
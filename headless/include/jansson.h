@@ -0,0 +1,162 @@
+#pragma once
+
+// Small in-memory subset of the jansson API, enough for the modules'
+// dataToJson()/dataFromJson() round trips in the headless harness.
+// Like jansson, the typed getters return 0 when the value has another type.
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+enum json_type {
+	JSON_OBJECT,
+	JSON_ARRAY,
+	JSON_STRING,
+	JSON_INTEGER,
+	JSON_REAL,
+	JSON_TRUE,
+	JSON_FALSE,
+	JSON_NULL
+};
+
+typedef long long json_int_t;
+
+struct json_t {
+	json_type type = JSON_NULL;
+	json_int_t integer = 0;
+	double real = 0.0;
+	std::string string;
+	std::vector<std::pair<std::string, json_t*>> object;
+	std::vector<json_t*> array;
+	size_t refcount = 1;
+};
+
+
+inline json_t* json_make(json_type type) {
+	auto* json = new json_t;
+	json->type = type;
+	return json;
+}
+
+inline void json_decref(json_t* json) {
+	if (!json || --json->refcount > 0)
+		return;
+	for (auto& entry : json->object)
+		json_decref(entry.second);
+	for (json_t* item : json->array)
+		json_decref(item);
+	delete json;
+}
+
+inline json_t* json_incref(json_t* json) {
+	if (json)
+		json->refcount++;
+	return json;
+}
+
+inline json_t* json_object() {
+	return json_make(JSON_OBJECT);
+}
+
+inline json_t* json_array() {
+	return json_make(JSON_ARRAY);
+}
+
+inline json_t* json_integer(json_int_t value) {
+	json_t* json = json_make(JSON_INTEGER);
+	json->integer = value;
+	return json;
+}
+
+inline json_t* json_real(double value) {
+	json_t* json = json_make(JSON_REAL);
+	json->real = value;
+	return json;
+}
+
+inline json_t* json_boolean(bool value) {
+	return json_make(value ? JSON_TRUE : JSON_FALSE);
+}
+
+inline json_t* json_true() {
+	return json_boolean(true);
+}
+
+inline json_t* json_false() {
+	return json_boolean(false);
+}
+
+inline json_t* json_string(const char* value) {
+	json_t* json = json_make(JSON_STRING);
+	json->string = value;
+	return json;
+}
+
+inline int json_object_set_new(json_t* object, const char* key, json_t* value) {
+	if (!object || object->type != JSON_OBJECT)
+		return -1;
+	for (auto& entry : object->object) {
+		if (entry.first == key) {
+			json_decref(entry.second);
+			entry.second = value;
+			return 0;
+		}
+	}
+	object->object.emplace_back(key, value);
+	return 0;
+}
+
+inline json_t* json_object_get(const json_t* object, const char* key) {
+	if (!object || object->type != JSON_OBJECT)
+		return nullptr;
+	for (const auto& entry : object->object) {
+		if (entry.first == key)
+			return entry.second;
+	}
+	return nullptr;
+}
+
+inline int json_array_append_new(json_t* array, json_t* value) {
+	if (!array || array->type != JSON_ARRAY)
+		return -1;
+	array->array.push_back(value);
+	return 0;
+}
+
+inline size_t json_array_size(const json_t* array) {
+	return array && array->type == JSON_ARRAY ? array->array.size() : 0;
+}
+
+inline json_t* json_array_get(const json_t* array, size_t index) {
+	if (index >= json_array_size(array))
+		return nullptr;
+	return array->array[index];
+}
+
+inline json_int_t json_integer_value(const json_t* json) {
+	return json && json->type == JSON_INTEGER ? json->integer : 0;
+}
+
+inline double json_real_value(const json_t* json) {
+	return json && json->type == JSON_REAL ? json->real : 0.0;
+}
+
+inline double json_number_value(const json_t* json) {
+	if (json && json->type == JSON_INTEGER)
+		return static_cast<double>(json->integer);
+	return json_real_value(json);
+}
+
+inline bool json_is_true(const json_t* json) {
+	return json && json->type == JSON_TRUE;
+}
+
+inline bool json_boolean_value(const json_t* json) {
+	return json_is_true(json);
+}
+
+inline const char* json_string_value(const json_t* json) {
+	return json && json->type == JSON_STRING ? json->string.c_str() : nullptr;
+}
@@ -0,0 +1,858 @@
+#pragma once
+
+// Minimal stand-in for the parts of the VCV Rack SDK that the Tyche sources use.
+// It is only good enough to construct modules, step them and read their ports
+// from a headless driver: widgets, menus and drawing compile but do nothing.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "jansson.h"
+#include "simd.hpp"
+
+
+#define ENUMS(name, count) name, name ## _LAST = name + (count) - 1
+
+
+namespace rack {
+
+static constexpr int PORT_MAX_CHANNELS = 16;
+
+static constexpr float RACK_GRID_WIDTH = 15.f;
+static constexpr float RACK_GRID_HEIGHT = 380.f;
+
+
+inline int clamp(int x, int a, int b) {
+	return std::max(std::min(x, b), a);
+}
+
+inline float clamp(float x, float a = 0.f, float b = 1.f) {
+	return std::fmax(std::fmin(x, std::fmax(a, b)), std::fmin(a, b));
+}
+
+inline float rescale(float x, float xMin, float xMax, float yMin, float yMax) {
+	return yMin + (x - xMin) / (xMax - xMin) * (yMax - yMin);
+}
+
+inline float crossfade(float a, float b, float p) {
+	return a + (b - a) * p;
+}
+
+
+namespace dsp {
+
+static constexpr float FREQ_A4 = 440.f;
+
+// Per-lane trigger for SIMD types; the float specialization below is the
+// scalar one.
+template <typename T = float>
+struct TSchmittTrigger {
+	T state = T::mask();
+
+	void reset() {
+		state = T::mask();
+	}
+
+	T process(T in, T lowThreshold = 0.f, T highThreshold = 1.f) {
+		const T on = in >= highThreshold;
+		const T off = in <= lowThreshold;
+		const T triggered = ~state & on;
+		state = on | (state & ~off);
+		return triggered;
+	}
+
+	T isHigh() const {
+		return state;
+	}
+};
+
+template <>
+struct TSchmittTrigger<float> {
+	bool state = true;
+
+	void reset() {
+		state = true;
+	}
+
+	bool process(float in, float lowThreshold = 0.f, float highThreshold = 1.f) {
+		if (state) {
+			if (in <= lowThreshold)
+				state = false;
+		} else if (in >= highThreshold) {
+			state = true;
+			return true;
+		}
+		return false;
+	}
+
+	bool isHigh() const {
+		return state;
+	}
+};
+
+typedef TSchmittTrigger<> SchmittTrigger;
+
+struct BooleanTrigger {
+	bool state = true;
+
+	void reset() {
+		state = true;
+	}
+
+	bool process(bool in) {
+		const bool triggered = in && !state;
+		state = in;
+		return triggered;
+	}
+};
+
+struct PulseGenerator {
+	float remaining = 0.f;
+
+	void reset() {
+		remaining = 0.f;
+	}
+
+	bool process(float deltaTime) {
+		if (remaining > 0.f) {
+			remaining -= deltaTime;
+			return true;
+		}
+		return false;
+	}
+
+	void trigger(float duration = 1e-3f) {
+		if (duration > remaining)
+			remaining = duration;
+	}
+};
+
+struct ClockDivider {
+	uint32_t clock = 0;
+	uint32_t division = 1;
+
+	void reset() {
+		clock = 0;
+	}
+
+	void setDivision(uint32_t division) {
+		this->division = division;
+	}
+
+	uint32_t getDivision() const {
+		return division;
+	}
+
+	bool process() {
+		clock++;
+		if (clock >= division) {
+			clock = 0;
+			return true;
+		}
+		return false;
+	}
+};
+
+inline float sinc(float x) {
+	if (x == 0.f)
+		return 1.f;
+	x *= static_cast<float>(M_PI);
+	return std::sin(x) / x;
+}
+
+inline float blackmanHarris(float p) {
+	const float a0 = 0.35875f, a1 = 0.48829f, a2 = 0.14128f, a3 = 0.01168f;
+	const float x = 2.f * static_cast<float>(M_PI) * p;
+	return a0 - a1 * std::cos(x) + a2 * std::cos(2.f * x) - a3 * std::cos(3.f * x);
+}
+
+inline void boxcarLowpassIR(float* out, int len, float cutoff) {
+	for (int i = 0; i < len; i++) {
+		const float t = i - (len - 1) / 2.f;
+		out[i] = 2.f * cutoff * sinc(2.f * cutoff * t);
+	}
+}
+
+inline void blackmanHarrisWindow(float* x, int len) {
+	for (int i = 0; i < len; i++)
+		x[i] *= blackmanHarris(static_cast<float>(i) / (len - 1));
+}
+
+template <int OVERSAMPLE, int QUALITY, typename T = float>
+struct Decimator {
+	T inBuffer[OVERSAMPLE * QUALITY];
+	float kernel[OVERSAMPLE * QUALITY];
+	int inIndex;
+
+	Decimator(float cutoff = 0.9f) {
+		boxcarLowpassIR(kernel, OVERSAMPLE * QUALITY, cutoff * 0.5f / OVERSAMPLE);
+		blackmanHarrisWindow(kernel, OVERSAMPLE * QUALITY);
+		reset();
+	}
+
+	void reset() {
+		inIndex = 0;
+		for (T& x : inBuffer)
+			x = T(0.f);
+	}
+
+	T process(T* in) {
+		for (int i = 0; i < OVERSAMPLE; i++)
+			inBuffer[inIndex + i] = in[i];
+		inIndex += OVERSAMPLE;
+		inIndex %= OVERSAMPLE * QUALITY;
+
+		T out = T(0.f);
+		for (int i = 0; i < OVERSAMPLE * QUALITY; i++) {
+			int index = inIndex - 1 - i;
+			index = (index + OVERSAMPLE * QUALITY) % (OVERSAMPLE * QUALITY);
+			out += kernel[i] * inBuffer[index];
+		}
+		return out;
+	}
+};
+
+} // namespace dsp
+
+
+namespace random {
+
+inline uint32_t u32() {
+	static uint64_t state = 0x853c49e6748fea9bULL;
+	state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return static_cast<uint32_t>(state >> 32);
+}
+
+inline float uniform() {
+	return (u32() >> 8) * (1.f / 16777216.f);
+}
+
+} // namespace random
+
+
+namespace plugin {
+struct Model;
+} // namespace plugin
+
+
+namespace engine {
+
+struct Param {
+	float value = 0.f;
+
+	float getValue() const {
+		return value;
+	}
+
+	void setValue(float value) {
+		this->value = value;
+	}
+};
+
+struct Port {
+	float voltages[PORT_MAX_CHANNELS] = {};
+	uint8_t channels = 0;
+
+	float getVoltage(int channel = 0) const {
+		return voltages[channel];
+	}
+
+	void setVoltage(float voltage, int channel = 0) {
+		voltages[channel] = voltage;
+	}
+
+	float getPolyVoltage(int channel) const {
+		return getVoltage(channels == 1 ? 0 : channel);
+	}
+
+	template <typename T>
+	T getVoltageSimd(int firstChannel) const {
+		return T::load(&voltages[firstChannel]);
+	}
+
+	template <typename T>
+	T getPolyVoltageSimd(int firstChannel) const {
+		return channels == 1 ? T(getVoltage(0)) : getVoltageSimd<T>(firstChannel);
+	}
+
+	template <typename T>
+	void setVoltageSimd(T voltage, int firstChannel) {
+		voltage.store(&voltages[firstChannel]);
+	}
+
+	int getChannels() const {
+		return channels;
+	}
+
+	void setChannels(int channels) {
+		// Like Rack, a disconnected port cannot be made polyphonic.
+		if (this->channels == 0)
+			return;
+		for (int c = channels; c < this->channels; c++)
+			voltages[c] = 0.f;
+		this->channels = std::max(channels, 1);
+	}
+
+	bool isConnected() const {
+		return channels > 0;
+	}
+
+	bool isMonophonic() const {
+		return channels == 1;
+	}
+
+	bool isPolyphonic() const {
+		return channels > 1;
+	}
+};
+
+struct Input : Port {};
+struct Output : Port {};
+
+struct Light {
+	float value = 0.f;
+
+	float getBrightness() const {
+		return value;
+	}
+
+	void setBrightness(float brightness) {
+		value = brightness;
+	}
+
+	// Lights turn on immediately and fade out, as in Rack.
+	void setBrightnessSmooth(float brightness, float deltaTime, float lambda = 30.f) {
+		if (brightness < value)
+			value += (brightness - value) * lambda * deltaTime;
+		else
+			value = brightness;
+	}
+};
+
+struct ParamQuantity {
+	float minValue = 0.f;
+	float maxValue = 1.f;
+	float defaultValue = 0.f;
+	std::string name;
+	std::string unit;
+	bool snapEnabled = false;
+};
+
+struct PortInfo {
+	std::string name;
+};
+
+
+struct Module {
+	plugin::Model* model = nullptr;
+	int64_t id = -1;
+
+	std::vector<Param> params;
+	std::vector<Input> inputs;
+	std::vector<Output> outputs;
+	std::vector<Light> lights;
+
+	std::vector<ParamQuantity*> paramQuantities;
+	std::vector<PortInfo*> inputInfos;
+	std::vector<PortInfo*> outputInfos;
+
+	struct Expander {
+		int64_t moduleId = -1;
+		Module* module = nullptr;
+		void* producerMessage = nullptr;
+		void* consumerMessage = nullptr;
+		bool messageFlipRequested = false;
+
+		void requestMessageFlip() {
+			messageFlipRequested = true;
+		}
+	};
+
+	Expander leftExpander;
+	Expander rightExpander;
+
+	bool bypassed = false;
+
+	struct ProcessArgs {
+		float sampleRate = 0.f;
+		float sampleTime = 0.f;
+		int64_t frame = 0;
+	};
+
+	struct ResetEvent {};
+	struct RandomizeEvent {};
+	struct ExpanderChangeEvent {
+		uint8_t side = 0;
+	};
+	struct BypassEvent {};
+	struct UnBypassEvent {};
+
+	Module() = default;
+	Module(const Module&) = delete;
+	Module& operator=(const Module&) = delete;
+
+	virtual ~Module() {
+		for (ParamQuantity* pq : paramQuantities)
+			delete pq;
+		for (PortInfo* info : inputInfos)
+			delete info;
+		for (PortInfo* info : outputInfos)
+			delete info;
+	}
+
+	void config(int numParams, int numInputs, int numOutputs, int numLights = 0) {
+		params.resize(numParams);
+		inputs.resize(numInputs);
+		outputs.resize(numOutputs);
+		lights.resize(numLights);
+		paramQuantities.resize(numParams, nullptr);
+		inputInfos.resize(numInputs, nullptr);
+		outputInfos.resize(numOutputs, nullptr);
+	}
+
+	ParamQuantity* configParam(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::string unit = "", float = 0.f, float = 1.f, float = 0.f) {
+		delete paramQuantities[paramId];
+		auto* pq = new ParamQuantity;
+		pq->minValue = minValue;
+		pq->maxValue = maxValue;
+		pq->defaultValue = defaultValue;
+		pq->name = std::move(name);
+		pq->unit = std::move(unit);
+		paramQuantities[paramId] = pq;
+		params[paramId].setValue(defaultValue);
+		return pq;
+	}
+
+	ParamQuantity* configButton(int paramId, std::string name = "") {
+		return configParam(paramId, 0.f, 1.f, 0.f, std::move(name));
+	}
+
+	ParamQuantity* configSwitch(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::vector<std::string> = {}) {
+		ParamQuantity* pq = configParam(paramId, minValue, maxValue, defaultValue, std::move(name));
+		pq->snapEnabled = true;
+		return pq;
+	}
+
+	PortInfo* configInput(int portId, std::string name = "") {
+		delete inputInfos[portId];
+		inputInfos[portId] = new PortInfo{std::move(name)};
+		return inputInfos[portId];
+	}
+
+	PortInfo* configOutput(int portId, std::string name = "") {
+		delete outputInfos[portId];
+		outputInfos[portId] = new PortInfo{std::move(name)};
+		return outputInfos[portId];
+	}
+
+	void configBypass(int, int) {}
+
+	Param& getParam(int index) {
+		return params[index];
+	}
+
+	Input& getInput(int index) {
+		return inputs[index];
+	}
+
+	Output& getOutput(int index) {
+		return outputs[index];
+	}
+
+	Light& getLight(int index) {
+		return lights[index];
+	}
+
+	ParamQuantity* getParamQuantity(int index) {
+		return paramQuantities[index];
+	}
+
+	Expander& getLeftExpander() {
+		return leftExpander;
+	}
+
+	Expander& getRightExpander() {
+		return rightExpander;
+	}
+
+	bool isBypassed() const {
+		return bypassed;
+	}
+
+	virtual void process(const ProcessArgs& args) {}
+	virtual void processBypass(const ProcessArgs& args) {}
+
+	virtual json_t* dataToJson() {
+		return nullptr;
+	}
+
+	virtual void dataFromJson(json_t* rootJ) {}
+
+	// Only the module's own data; params and bypass state are not restored.
+	virtual void fromJson(json_t* rootJ) {
+		json_t* dataJ = json_object_get(rootJ, "data");
+		if (dataJ)
+			dataFromJson(dataJ);
+	}
+
+	virtual void onReset(const ResetEvent& e) {
+		for (size_t i = 0; i < params.size(); i++) {
+			if (paramQuantities[i])
+				params[i].setValue(paramQuantities[i]->defaultValue);
+		}
+	}
+
+	virtual void onRandomize(const RandomizeEvent& e) {}
+	virtual void onExpanderChange(const ExpanderChangeEvent& e) {}
+	virtual void onBypass(const BypassEvent& e) {}
+	virtual void onUnBypass(const UnBypassEvent& e) {}
+	virtual void onSampleRateChange() {}
+};
+
+} // namespace engine
+
+
+namespace math {
+
+struct Vec {
+	float x = 0.f;
+	float y = 0.f;
+
+	Vec() = default;
+	Vec(float x, float y) : x(x), y(y) {}
+};
+
+struct Rect {
+	Vec pos;
+	Vec size;
+};
+
+} // namespace math
+
+
+inline math::Vec mm2px(math::Vec mm) {
+	return math::Vec(mm.x * 75.f / 25.4f, mm.y * 75.f / 25.4f);
+}
+
+
+struct NVGcolor {
+	float r, g, b, a;
+};
+
+struct NVGcontext;
+
+inline NVGcolor nvgRGB(unsigned char r, unsigned char g, unsigned char b) {
+	return NVGcolor{r / 255.f, g / 255.f, b / 255.f, 1.f};
+}
+
+inline NVGcolor nvgRGBA(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+	return NVGcolor{r / 255.f, g / 255.f, b / 255.f, a / 255.f};
+}
+
+inline void nvgBeginPath(NVGcontext*) {}
+inline void nvgRect(NVGcontext*, float, float, float, float) {}
+inline void nvgRoundedRect(NVGcontext*, float, float, float, float, float) {}
+inline void nvgCircle(NVGcontext*, float, float, float) {}
+inline void nvgFillColor(NVGcontext*, NVGcolor) {}
+inline void nvgFill(NVGcontext*) {}
+inline void nvgStrokeColor(NVGcontext*, NVGcolor) {}
+inline void nvgStrokeWidth(NVGcontext*, float) {}
+inline void nvgStroke(NVGcontext*) {}
+
+
+namespace widget {
+
+struct Widget {
+	math::Rect box;
+	std::vector<Widget*> children;
+
+	struct DrawArgs {
+		NVGcontext* vg = nullptr;
+	};
+
+	virtual ~Widget() {
+		for (Widget* child : children)
+			delete child;
+	}
+
+	void addChild(Widget* child) {
+		if (child)
+			children.push_back(child);
+	}
+
+	virtual void step() {}
+	virtual void draw(const DrawArgs& args) {}
+	virtual void drawLayer(const DrawArgs& args, int layer) {}
+};
+
+struct TransparentWidget : Widget {};
+
+} // namespace widget
+
+
+namespace ui {
+
+struct MenuItem : widget::Widget {
+	std::string text;
+	std::string rightText;
+	bool disabled = false;
+};
+
+struct MenuLabel : widget::Widget {
+	std::string text;
+};
+
+struct MenuSeparator : widget::Widget {};
+
+struct Menu : widget::Widget {};
+
+} // namespace ui
+
+
+namespace app {
+
+struct ParamWidget : widget::Widget {};
+struct PortWidget : widget::Widget {};
+struct LightWidget : widget::Widget {};
+
+struct SvgPanel : widget::Widget {};
+
+struct ModuleWidget : widget::Widget {
+	engine::Module* module = nullptr;
+
+	void setModule(engine::Module* module) {
+		this->module = module;
+	}
+
+	template <class TModule>
+	TModule* getModule() {
+		return dynamic_cast<TModule*>(module);
+	}
+
+	void setPanel(widget::Widget* panel) {
+		if (panel)
+			addChild(panel);
+		box.size = math::Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT);
+	}
+
+	void addParam(ParamWidget* param) {
+		addChild(param);
+	}
+
+	void addInput(PortWidget* input) {
+		addChild(input);
+	}
+
+	void addOutput(PortWidget* output) {
+		addChild(output);
+	}
+
+	virtual void appendContextMenu(ui::Menu* menu) {}
+};
+
+} // namespace app
+
+
+namespace componentlibrary {
+
+struct RedGreenBlueLight : app::LightWidget {};
+struct GreenRedLight : app::LightWidget {};
+struct RedLight : app::LightWidget {};
+struct GreenLight : app::LightWidget {};
+struct YellowLight : app::LightWidget {};
+
+template <typename TBase>
+struct SmallLight : TBase {};
+
+template <typename TBase>
+struct MediumLight : TBase {};
+
+template <typename TBase>
+struct VCVBezelLight : TBase {};
+
+struct VCVBezel : app::ParamWidget {};
+
+template <typename TBase, typename TLight>
+struct LightButton : TBase {};
+
+template <typename TLightBase>
+struct VCVLightSlider : app::ParamWidget {};
+
+struct RoundKnob : app::ParamWidget {
+	bool snap = false;
+};
+
+struct RoundBlackKnob : RoundKnob {};
+struct RoundSmallBlackKnob : RoundKnob {};
+struct Trimpot : RoundKnob {};
+
+struct DarkPJ301MPort : app::PortWidget {};
+struct PJ301MPort : app::PortWidget {};
+
+struct ScrewSilver : widget::Widget {};
+
+} // namespace componentlibrary
+
+
+namespace plugin {
+
+struct Model {
+	std::string slug;
+
+	virtual ~Model() = default;
+	virtual engine::Module* createModule() = 0;
+};
+
+struct Plugin {
+	std::vector<Model*> models;
+
+	void addModel(Model* model) {
+		models.push_back(model);
+	}
+
+	Model* getModel(const std::string& slug) const {
+		for (Model* model : models) {
+			if (model->slug == slug)
+				return model;
+		}
+		return nullptr;
+	}
+};
+
+} // namespace plugin
+
+
+namespace asset {
+
+inline std::string plugin(plugin::Plugin*, const std::string& filename) {
+	return filename;
+}
+
+} // namespace asset
+
+
+namespace string {
+
+inline std::string f(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	char buffer[1024];
+	std::vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	return buffer;
+}
+
+} // namespace string
+
+
+using namespace engine;
+using namespace math;
+using namespace widget;
+using namespace app;
+using namespace componentlibrary;
+using namespace plugin;
+using ui::Menu;
+using ui::MenuItem;
+using ui::MenuLabel;
+using ui::MenuSeparator;
+
+
+template <class TModule, class TModuleWidget>
+Model* createModel(const std::string& slug) {
+	struct TModel : Model {
+		engine::Module* createModule() override {
+			return new TModule;
+		}
+	};
+
+	Model* model = new TModel;
+	model->slug = slug;
+	return model;
+}
+
+inline widget::Widget* createPanel(const std::string& svgPath) {
+	return new app::SvgPanel;
+}
+
+template <class TWidget>
+TWidget* createWidget(math::Vec pos) {
+	auto* o = new TWidget;
+	o->box.pos = pos;
+	return o;
+}
+
+template <class TWidget>
+TWidget* createWidgetCentered(math::Vec pos) {
+	return createWidget<TWidget>(pos);
+}
+
+template <class TParamWidget>
+TParamWidget* createParamCentered(math::Vec pos, engine::Module* module, int paramId) {
+	return createWidget<TParamWidget>(pos);
+}
+
+template <class TParamWidget>
+TParamWidget* createLightParamCentered(math::Vec pos, engine::Module* module, int paramId, int firstLightId) {
+	return createWidget<TParamWidget>(pos);
+}
+
+template <class TPortWidget>
+TPortWidget* createInputCentered(math::Vec pos, engine::Module* module, int inputId) {
+	return createWidget<TPortWidget>(pos);
+}
+
+template <class TPortWidget>
+TPortWidget* createOutputCentered(math::Vec pos, engine::Module* module, int outputId) {
+	return createWidget<TPortWidget>(pos);
+}
+
+template <class TLightWidget>
+TLightWidget* createLightCentered(math::Vec pos, engine::Module* module, int firstLightId) {
+	return createWidget<TLightWidget>(pos);
+}
+
+inline ui::MenuLabel* createMenuLabel(const std::string& text) {
+	auto* label = new ui::MenuLabel;
+	label->text = text;
+	return label;
+}
+
+inline ui::MenuItem* createMenuItem(const std::string& text, const std::string& rightText = "", std::function<void()> action = nullptr) {
+	auto* item = new ui::MenuItem;
+	item->text = text;
+	item->rightText = rightText;
+	return item;
+}
+
+inline ui::MenuItem* createSubmenuItem(const std::string& text, const std::string& rightText, std::function<void(ui::Menu*)> createMenu) {
+	return createMenuItem(text, rightText);
+}
+
+inline ui::MenuItem* createBoolMenuItem(const std::string& text, const std::string& rightText, std::function<bool()> getter, std::function<void(bool)> setter) {
+	return createMenuItem(text, rightText);
+}
+
+inline ui::MenuItem* createBoolPtrMenuItem(const std::string& text, const std::string& rightText, bool* ptr) {
+	return createMenuItem(text, rightText);
+}
+
+inline ui::MenuItem* createIndexSubmenuItem(const std::string& text, const std::vector<std::string>& labels, std::function<size_t()> getter, std::function<void(size_t)> setter) {
+	return createMenuItem(text);
+}
+
+template <typename T>
+ui::MenuItem* createIndexPtrSubmenuItem(const std::string& text, const std::vector<std::string>& labels, T* ptr) {
+	return createMenuItem(text);
+}
+
+} // namespace rack
@@ -0,0 +1,209 @@
+#pragma once
+
+// SSE-backed subset of rack::simd used by the Tyche sources.
+
+#include <cmath>
+#include <cstdint>
+
+#include <immintrin.h>
+
+
+namespace rack {
+namespace simd {
+
+template <typename T, int N>
+struct Vector;
+
+
+template <>
+struct Vector<int32_t, 4>;
+
+
+template <>
+struct Vector<float, 4> {
+	using type = float;
+	constexpr static int size = 4;
+
+	union {
+		__m128 v;
+		float s[4];
+	};
+
+	Vector() = default;
+
+	Vector(__m128 v) : v(v) {}
+
+	Vector(float x) {
+		v = _mm_set1_ps(x);
+	}
+
+	Vector(float x1, float x2, float x3, float x4) {
+		v = _mm_setr_ps(x1, x2, x3, x4);
+	}
+
+	explicit Vector(Vector<int32_t, 4> a);
+
+	static Vector zero() {
+		return Vector(_mm_setzero_ps());
+	}
+
+	static Vector mask() {
+		return Vector(_mm_castsi128_ps(_mm_set1_epi32(-1)));
+	}
+
+	static Vector load(const float* x) {
+		return Vector(_mm_loadu_ps(x));
+	}
+
+	void store(float* x) const {
+		_mm_storeu_ps(x, v);
+	}
+
+	static Vector cast(Vector<int32_t, 4> a);
+
+	float& operator[](int i) {
+		return s[i];
+	}
+
+	const float& operator[](int i) const {
+		return s[i];
+	}
+};
+
+
+template <>
+struct Vector<int32_t, 4> {
+	using type = int32_t;
+	constexpr static int size = 4;
+
+	union {
+		__m128i v;
+		int32_t s[4];
+	};
+
+	Vector() = default;
+
+	Vector(__m128i v) : v(v) {}
+
+	Vector(int32_t x) {
+		v = _mm_set1_epi32(x);
+	}
+
+	Vector(int32_t x1, int32_t x2, int32_t x3, int32_t x4) {
+		v = _mm_setr_epi32(x1, x2, x3, x4);
+	}
+
+	explicit Vector(Vector<float, 4> a) {
+		v = _mm_cvttps_epi32(a.v);
+	}
+
+	static Vector zero() {
+		return Vector(_mm_setzero_si128());
+	}
+
+	static Vector load(const int32_t* x) {
+		return Vector(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x)));
+	}
+
+	void store(int32_t* x) const {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(x), v);
+	}
+
+	static Vector cast(Vector<float, 4> a) {
+		return Vector(_mm_castps_si128(a.v));
+	}
+
+	int32_t& operator[](int i) {
+		return s[i];
+	}
+
+	const int32_t& operator[](int i) const {
+		return s[i];
+	}
+};
+
+
+inline Vector<float, 4>::Vector(Vector<int32_t, 4> a) {
+	v = _mm_cvtepi32_ps(a.v);
+}
+
+inline Vector<float, 4> Vector<float, 4>::cast(Vector<int32_t, 4> a) {
+	return Vector(_mm_castsi128_ps(a.v));
+}
+
+
+using float_4 = Vector<float, 4>;
+using int32_4 = Vector<int32_t, 4>;
+
+
+inline float_4 operator+(float_4 a, float_4 b) { return float_4(_mm_add_ps(a.v, b.v)); }
+inline float_4 operator-(float_4 a, float_4 b) { return float_4(_mm_sub_ps(a.v, b.v)); }
+inline float_4 operator*(float_4 a, float_4 b) { return float_4(_mm_mul_ps(a.v, b.v)); }
+inline float_4 operator/(float_4 a, float_4 b) { return float_4(_mm_div_ps(a.v, b.v)); }
+inline float_4 operator-(float_4 a) { return float_4(_mm_sub_ps(_mm_setzero_ps(), a.v)); }
+
+inline float_4& operator+=(float_4& a, float_4 b) { return a = a + b; }
+inline float_4& operator-=(float_4& a, float_4 b) { return a = a - b; }
+inline float_4& operator*=(float_4& a, float_4 b) { return a = a * b; }
+inline float_4& operator/=(float_4& a, float_4 b) { return a = a / b; }
+
+inline float_4 operator==(float_4 a, float_4 b) { return float_4(_mm_cmpeq_ps(a.v, b.v)); }
+inline float_4 operator!=(float_4 a, float_4 b) { return float_4(_mm_cmpneq_ps(a.v, b.v)); }
+inline float_4 operator<(float_4 a, float_4 b) { return float_4(_mm_cmplt_ps(a.v, b.v)); }
+inline float_4 operator<=(float_4 a, float_4 b) { return float_4(_mm_cmple_ps(a.v, b.v)); }
+inline float_4 operator>(float_4 a, float_4 b) { return float_4(_mm_cmpgt_ps(a.v, b.v)); }
+inline float_4 operator>=(float_4 a, float_4 b) { return float_4(_mm_cmpge_ps(a.v, b.v)); }
+
+inline float_4 operator&(float_4 a, float_4 b) { return float_4(_mm_and_ps(a.v, b.v)); }
+inline float_4 operator|(float_4 a, float_4 b) { return float_4(_mm_or_ps(a.v, b.v)); }
+inline float_4 operator^(float_4 a, float_4 b) { return float_4(_mm_xor_ps(a.v, b.v)); }
+inline float_4 operator~(float_4 a) { return a ^ float_4::mask(); }
+
+inline float_4& operator&=(float_4& a, float_4 b) { return a = a & b; }
+inline float_4& operator|=(float_4& a, float_4 b) { return a = a | b; }
+
+inline int32_4 operator+(int32_4 a, int32_4 b) { return int32_4(_mm_add_epi32(a.v, b.v)); }
+inline int32_4 operator-(int32_4 a, int32_4 b) { return int32_4(_mm_sub_epi32(a.v, b.v)); }
+inline int32_4 operator&(int32_4 a, int32_4 b) { return int32_4(_mm_and_si128(a.v, b.v)); }
+inline int32_4 operator|(int32_4 a, int32_4 b) { return int32_4(_mm_or_si128(a.v, b.v)); }
+inline int32_4 operator^(int32_4 a, int32_4 b) { return int32_4(_mm_xor_si128(a.v, b.v)); }
+inline int32_4 operator==(int32_4 a, int32_4 b) { return int32_4(_mm_cmpeq_epi32(a.v, b.v)); }
+inline int32_4 operator>(int32_4 a, int32_4 b) { return int32_4(_mm_cmpgt_epi32(a.v, b.v)); }
+
+
+inline float_4 ifelse(float_4 mask, float_4 a, float_4 b) {
+	return float_4(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+}
+
+inline int movemask(float_4 a) {
+	return _mm_movemask_ps(a.v);
+}
+
+inline float_4 fmax(float_4 a, float_4 b) { return float_4(_mm_max_ps(a.v, b.v)); }
+inline float_4 fmin(float_4 a, float_4 b) { return float_4(_mm_min_ps(a.v, b.v)); }
+inline float_4 sqrt(float_4 a) { return float_4(_mm_sqrt_ps(a.v)); }
+inline float_4 fabs(float_4 a) { return a & float_4::cast(int32_4(0x7fffffff)); }
+
+inline float_4 clamp(float_4 x, float_4 a = 0.f, float_4 b = 1.f) {
+	return fmin(fmax(x, a), b);
+}
+
+inline float_4 floor(float_4 a) {
+	float_4 t = float_4(int32_4(a));
+	return t - (ifelse(t > a, float_4(1.f), float_4::zero()));
+}
+
+inline float_4 crossfade(float_4 a, float_4 b, float_4 p) {
+	return a + (b - a) * p;
+}
+
+inline float_4 pow(float_4 a, float_4 b) {
+	return float_4(std::pow(a[0], b[0]), std::pow(a[1], b[1]), std::pow(a[2], b[2]), std::pow(a[3], b[3]));
+}
+
+inline float_4 exp(float_4 a) {
+	return float_4(std::exp(a[0]), std::exp(a[1]), std::exp(a[2]), std::exp(a[3]));
+}
+
+} // namespace simd
+} // namespace rack
@@ -0,0 +1,229 @@
+// Microbenchmarks for the Tyche modules, written as JSON so results can be
+// compared between releases:
+//
+//   make -C headless micro                  writes build/micro.json
+//   build/micro [--quick] [--label NAME] [--out FILE]
+//
+// Three sections:
+//   noise    construction of the scalar and four-lane noise tables, and eval
+//            throughput per point: scalar 2D, 3D and 4D, and four-lane 2D (the
+//            only batched kernel) with shared or separate x coordinates.
+//   chain    cost of event delivery along the expander chain: Omen followed by
+//            1 to 128 Blanks, which do nothing but follow the chain, with
+//            same-sample delivery and with one hop per frame.
+//   modules  process() cost of each module with the patching of Harness.hpp,
+//            from a row of identical modules behind Omen minus Omen alone.
+//
+// Every figure is the fastest of several rounds, which is the least disturbed
+// by whatever else the machine is doing.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Harness.hpp"
+#include "OpenSimplexNoise/OpenSimplexNoise.h"
+#include "../src/SimdNoise.h"
+
+
+using namespace harness;
+
+
+struct Result {
+	std::string section;
+	std::string name;
+	double value;
+	const char* unit;
+};
+
+// Keeps the optimizer from dropping the measured work.
+static volatile double sink;
+
+
+// Fastest of `rounds` runs of body(iterations), in ns per iteration.
+template <typename F>
+static double fastest(const int rounds, const int64_t iterations, F body) {
+	double best = 1e300;
+	for (int r = 0; r < rounds; r++) {
+		const auto start = Clock::now();
+		body(iterations);
+		const auto end = Clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations));
+	}
+	return best;
+}
+
+
+// Points along the paths the modules walk: a small variant coordinate and a
+// phase that grows by a sample at a time.
+static constexpr int POINTS = 4096;
+
+static void noiseBenchmarks(std::vector<Result>& results, const int rounds, const int64_t scale) {
+	const int64_t constructions = scale / 64;
+	results.push_back({"noise", "construct.scalar", fastest(rounds, constructions, [](const int64_t n) {
+		double total = 0.0;
+		for (int64_t i = 0; i < n; i++) {
+			const OpenSimplexNoise::Noise noise(i);
+			total += noise.eval(0.5, 0.5);
+		}
+		sink = total;
+	}), "ns/table"});
+	results.push_back({"noise", "construct.simd", fastest(rounds, constructions, [](const int64_t n) {
+		float total = 0.f;
+		for (int64_t i = 0; i < n; i++) {
+			const SimdNoise noise(i);
+			const double y[4] = {0.5, 0.5, 0.5, 0.5};
+			total += noise.eval(0.5, y)[0];
+		}
+		sink = total;
+	}), "ns/table"});
+
+	const OpenSimplexNoise::Noise noise(1234);
+	const SimdNoise simdNoise(1234);
+
+	double xs[POINTS];
+	double ys[POINTS];
+	for (int i = 0; i < POINTS; i++) {
+		xs[i] = 1.0 + (i % 4) * 256.0;
+		ys[i] = 3600.0 + i / 48000.0;
+	}
+
+	const int64_t passes = std::max<int64_t>(1, scale / POINTS);
+	const int64_t points = passes * POINTS;
+	auto perPoint = [&](const char* name, void (*body)(const OpenSimplexNoise::Noise&, const SimdNoise&, const double*, const double*, double&)) {
+		const double ns = fastest(rounds, passes, [&](const int64_t n) {
+			double total = 0.0;
+			for (int64_t i = 0; i < n; i++)
+				body(noise, simdNoise, xs, ys, total);
+			sink = total;
+		});
+		results.push_back({"noise", name, ns * passes / points, "ns/point"});
+	};
+
+	perPoint("eval2.scalar", [](const OpenSimplexNoise::Noise& noise, const SimdNoise&, const double* x, const double* y, double& total) {
+		for (int i = 0; i < POINTS; i++)
+			total += noise.eval(x[i], y[i]);
+	});
+	perPoint("eval3.scalar", [](const OpenSimplexNoise::Noise& noise, const SimdNoise&, const double* x, const double* y, double& total) {
+		for (int i = 0; i < POINTS; i++)
+			total += noise.eval(x[i], y[i], 0.25);
+	});
+	perPoint("eval4.scalar", [](const OpenSimplexNoise::Noise& noise, const SimdNoise&, const double* x, const double* y, double& total) {
+		for (int i = 0; i < POINTS; i++)
+			total += noise.eval(x[i], y[i], 0.25, 0.75);
+	});
+	perPoint("eval2.simd", [](const OpenSimplexNoise::Noise&, const SimdNoise& noise, const double* x, const double* y, double& total) {
+		float_4 sum = 0.f;
+		for (int i = 0; i < POINTS; i += 4)
+			sum += noise.eval(&x[i], &y[i]);
+		total += sum[0] + sum[1] + sum[2] + sum[3];
+	});
+	perPoint("eval2.simd.shared-x", [](const OpenSimplexNoise::Noise&, const SimdNoise& noise, const double* x, const double* y, double& total) {
+		float_4 sum = 0.f;
+		for (int i = 0; i < POINTS; i += 4)
+			sum += noise.eval(x[i], &y[i]);
+		total += sum[0] + sum[1] + sum[2] + sum[3];
+	});
+}
+
+
+static double measureRow(const std::vector<std::string>& slugs, const int64_t frames, const int rounds, const bool sameSample = true) {
+	double best = 1e300;
+	for (int r = 0; r < rounds; r++) {
+		Rack rack;
+		ClockScript script;
+		script.sampleRate = rack.sampleRate;
+
+		setSameSampleDelivery(rack.add("Omen"), sameSample);
+		for (const std::string& slug : slugs)
+			rack.add(slug);
+
+		best = std::min(best, nsPerFrame(rack, script, frames));
+	}
+	return best;
+}
+
+static void chainBenchmarks(std::vector<Result>& results, const int rounds, const int64_t frames) {
+	const double omenOnly = measureRow({}, frames, rounds);
+	results.push_back({"chain", "omen", omenOnly, "ns/frame"});
+
+	for (int length = 1; length <= 128; length *= 2) {
+		const std::vector<std::string> row(length, "Blank");
+		const std::string name = "blank" + std::to_string(length);
+		const double sameSample = measureRow(row, frames, rounds);
+		const double hop = measureRow(row, frames, rounds, false);
+		results.push_back({"chain", name + ".same-sample", sameSample, "ns/frame"});
+		results.push_back({"chain", name + ".same-sample.member", (sameSample - omenOnly) / length, "ns/frame"});
+		results.push_back({"chain", name + ".hop", hop, "ns/frame"});
+		results.push_back({"chain", name + ".hop.member", (hop - omenOnly) / length, "ns/frame"});
+	}
+}
+
+
+static void moduleBenchmarks(std::vector<Result>& results, const int rounds, const int64_t frames) {
+	static const int ROW = 16;
+	const double omenOnly = measureRow({}, frames, rounds);
+	results.push_back({"modules", "Omen", omenOnly, "ns/frame"});
+
+	for (const char* slug : {"Blank", "Kron", "Tale", "Fate", "Moira", "Clotho", "Horae", "Lachesis"}) {
+		const std::vector<std::string> row(ROW, slug);
+		results.push_back({"modules", slug, (measureRow(row, frames, rounds) - omenOnly) / ROW, "ns/frame"});
+	}
+}
+
+
+static void writeJson(FILE* file, const std::string& label, const bool quick, const std::vector<Result>& results) {
+	std::fprintf(file, "{\n");
+	std::fprintf(file, "  \"schema\": 1,\n");
+	std::fprintf(file, "  \"label\": \"%s\",\n", label.c_str());
+	std::fprintf(file, "  \"compiler\": \"%s\",\n", __VERSION__);
+	std::fprintf(file, "  \"quick\": %s,\n", quick ? "true" : "false");
+	std::fprintf(file, "  \"results\": [\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		std::fprintf(file, "    {\"section\": \"%s\", \"name\": \"%s\", \"value\": %.3f, \"unit\": \"%s\"}%s\n",
+			r.section.c_str(), r.name.c_str(), r.value, r.unit, i + 1 < results.size() ? "," : "");
+	}
+	std::fprintf(file, "  ]\n");
+	std::fprintf(file, "}\n");
+}
+
+
+int main(int argc, char** argv) {
+	std::string label;
+	std::string out;
+	bool quick = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "--quick"))
+			quick = true;
+		else if (!std::strcmp(argv[i], "--label") && i + 1 < argc)
+			label = argv[++i];
+		else if (!std::strcmp(argv[i], "--out") && i + 1 < argc)
+			out = argv[++i];
+	}
+
+	// --quick is for checking the benchmarks themselves, not for figures.
+	const int rounds = quick ? 1 : 5;
+	const int64_t noiseScale = quick ? 1 << 16 : 1 << 22;
+	const int64_t frames = quick ? 4800 : 48000;
+
+	std::vector<Result> results;
+	noiseBenchmarks(results, rounds, noiseScale);
+	chainBenchmarks(results, rounds, frames);
+	moduleBenchmarks(results, rounds, frames);
+
+	FILE* file = out.empty() ? stdout : std::fopen(out.c_str(), "w");
+	if (!file) {
+		std::fprintf(stderr, "micro: cannot write %s\n", out.c_str());
+		return 1;
+	}
+	writeJson(file, label, quick, results);
+	if (file != stdout) {
+		std::fclose(file);
+		std::printf("wrote %s\n", out.c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Walker/Vose alias table over up to N outcomes. Built in O(n) from relative
+// weights; sampling costs one multiply, one lookup and one comparison whatever
+// the number of outcomes.
+template <int N>
+struct AliasTable {
+    // Outcomes the table was built for; 0 if no weight was positive.
+    int size = 0;
+
+    // Builds the table for weights[0..n). Negative weights count as 0.
+    void build(const float* weights, const int n)
+    {
+        size = 0;
+
+        float total = 0.f;
+        for (int i = 0; i < n; i++)
+            total += std::fmax(weights[i], 0.f);
+        if (!(total > 0.f))
+            return;
+
+        float scaled[N];
+        int small[N];
+        int large[N];
+        int smallCount = 0;
+        int largeCount = 0;
+        for (int i = 0; i < n; i++) {
+            scaled[i] = std::fmax(weights[i], 0.f) * n / total;
+            if (scaled[i] < 1.f)
+                small[smallCount++] = i;
+            else
+                large[largeCount++] = i;
+        }
+
+        int lastLarge = large[0];
+        while (smallCount > 0 && largeCount > 0) {
+            const int s = small[--smallCount];
+            const int l = large[--largeCount];
+            threshold[s] = scaled[s];
+            alias[s] = static_cast<uint8_t>(l);
+
+            scaled[l] = (scaled[l] + scaled[s]) - 1.f;
+            if (scaled[l] < 1.f)
+                small[smallCount++] = l;
+            else
+                large[largeCount++] = l;
+            lastLarge = l;
+        }
+
+        // Whatever is left is 1 up to rounding. An outcome with no weight must
+        // never be picked, though, so it always defers to a weighted one.
+        while (largeCount > 0) {
+            const int l = large[--largeCount];
+            threshold[l] = 1.f;
+            alias[l] = static_cast<uint8_t>(l);
+        }
+        while (smallCount > 0) {
+            const int s = small[--smallCount];
+            const bool weighted = weights[s] > 0.f;
+            threshold[s] = weighted ? 1.f : 0.f;
+            alias[s] = static_cast<uint8_t>(weighted ? s : lastLarge);
+        }
+
+        size = n;
+    }
+
+    // Outcome for a uniform u in [0, 1). Only valid if size > 0.
+    int sample(const float u) const
+    {
+        const float x = u * size;
+        int column = static_cast<int>(x);
+        if (column >= size)
+            column = size - 1;
+        return x - column < threshold[column] ? column : alias[column];
+    }
+
+    // Probability of outcome i, for displays.
+    float probability(const int i) const
+    {
+        if (size == 0)
+            return 0.f;
+
+        float p = threshold[i];
+        for (int j = 0; j < size; j++) {
+            if (j != i && alias[j] == i)
+                p += 1.f - threshold[j];
+        }
+        return p / size;
+    }
+
+private:
+    float threshold[N] = {};
+    uint8_t alias[N] = {};
+};
+
+// OpenSimplex noise is far from uniform, most values lie near 0. Its fine
+// structure is, though: the fractional part of the value scaled by 256 is
+// uniform on [0, 1) to within about half a percent per bin.
+inline float uniformFromNoise(const double noiseVal)
+{
+    const double u = (noiseVal + 1.0) * 128.0;
+    return static_cast<float>(u - std::floor(u));
+}
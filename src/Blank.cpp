@@ -19,6 +19,11 @@ struct Blank final : DaisyExpander {
 	Blank() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 	}
+
+	void process(const ProcessArgs& args) override {
+		TYCHE_STATS_PROCESS(args);
+		DaisyExpander::process(args);
+	}
 };
 
 
@@ -32,6 +37,12 @@ struct BlankWidget final : ModuleWidget {
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 	}
+
+#ifdef TYCHE_STATS
+	void appendContextMenu(ui::Menu* menu) override {
+		appendStatsMenu(menu, getModule<Blank>()->stats);
+	}
+#endif
 };
 
 
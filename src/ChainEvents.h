@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+enum class ChainEventType : uint8_t { SEED, RESET, CLOCK };
+
+// Something Omen detected on a given frame. Events of one frame are queued in
+// the order members handle them: seed, reset, clock.
+struct ChainEvent {
+    uint64_t seq = 0;
+    // Engine frame the head detected the event on.
+    int64_t frame = 0;
+    ChainEventType type = ChainEventType::CLOCK;
+    int seed = 0;
+    uint32_t clock = 0;
+    // For CLOCK events: Omen's smoothed time of this tick in frames, and its
+    // tempo in frames per tick, 0 until it has one. See TempoTracker.
+    double tickTime = 0.0;
+    float samplesPerTick = 0.f;
+};
+
+// Bounded, lock-free broadcast queue of chain events. The head is the only
+// writer; every member reads it with its own cursor, so nothing is copied from
+// module to module and nothing is written on frames without events.
+//
+// The head queues at most three events per frame and members read at most one
+// frame per chain position behind it, so a slot is only reused long after every
+// member has read it unless the chain is hundreds of modules long. A reader that
+// falls further behind loses the oldest events rather than blocking the head.
+class ChainEventQueue {
+public:
+    static constexpr uint64_t CAPACITY = 1024;
+
+    void push(ChainEvent event)
+    {
+        const uint64_t seq = written.load(std::memory_order_relaxed);
+        event.seq = seq;
+        events[seq % CAPACITY] = event;
+        written.store(seq + 1, std::memory_order_release);
+    }
+
+    // Sequence number of the oldest event still held.
+    uint64_t begin() const
+    {
+        const uint64_t end = this->end();
+        return end > CAPACITY ? end - CAPACITY : 0;
+    }
+
+    // Sequence number the next event will get.
+    uint64_t end() const
+    {
+        return written.load(std::memory_order_acquire);
+    }
+
+    // Valid for begin() <= seq < end().
+    const ChainEvent& at(const uint64_t seq) const
+    {
+        return events[seq % CAPACITY];
+    }
+
+private:
+    ChainEvent events[CAPACITY];
+    std::atomic<uint64_t> written{0};
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// Stateless counter-based random numbers for modules that only need one
+// uniform number per decision. uniform() is a pure function of a seed, a
+// stream and a counter: two rounds of the SplitMix64 finalizer, a dozen
+// integer operations and no tables or state, so any decision can be recomputed
+// on its own and lanes never depend on each other.
+//
+// Unlike the simplex noise, neighbouring counters are independent and the
+// result is uniform, so a probability knob at 30% gives 30%.
+struct CounterRng {
+    // Where a module takes its decisions from, saved in patches as
+    // "randomSource". Patches saved before the option existed use SIMPLEX.
+    enum Source { SIMPLEX, COUNTER, SOURCES_LEN };
+
+    // Streams of one variant are as far apart as the channels on the noise plane.
+    static constexpr uint32_t LANE_SPREAD = 256;
+
+    static uint32_t stream(const float variant, const int lane)
+    {
+        return static_cast<uint32_t>(variant) + static_cast<uint32_t>(lane) * LANE_SPREAD;
+    }
+
+    // Uniform on [0, 1) with 24 bits of resolution.
+    static float uniform(const int seed, const uint32_t stream, const uint64_t counter)
+    {
+        const uint64_t key = mix((static_cast<uint64_t>(static_cast<uint32_t>(seed)) << 32) | stream);
+        return static_cast<float>(mix(key ^ counter) >> 40) * (1.f / 16777216.f);
+    }
+
+private:
+    static uint64_t mix(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+};
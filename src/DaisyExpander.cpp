@@ -1,63 +1,148 @@
+#include <algorithm>
+
 #include "DaisyExpander.h"
 
-template<typename T, typename ...Args>
-std::unique_ptr<T> make_unique(Args&& ...args)
+DaisyExpander::DaisyExpander() : noiseTables(NoiseRegistry::defaultTables())
 {
-    return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
+    NoiseRegistry::instance().addUser();
+    noise = noiseTables->noise();
+    simdNoise = noiseTables->simdNoise();
 }
 
-DaisyExpander::DaisyExpander() : noise(make_unique<OpenSimplexNoise::Noise>())
+DaisyExpander::~DaisyExpander()
 {
-    getLeftExpander().producerMessage = &messages[0];
-    getLeftExpander().consumerMessage = &messages[1];
+    NoiseRegistry::instance().release(noiseTables);
+    NoiseRegistry::instance().removeUser();
 }
 
 void DaisyExpander::process(const ProcessArgs& args)
 {
-    processIncomingMessage();
+    if (!chainHead)
+        return;
+
+    if (chainHead->sameSampleDelivery)
+        chainHead->publish(args.frame);
+
+    processEvents(args.frame);
 }
 
-void DaisyExpander::reseedNoise(const int seed)
+void DaisyExpander::onExpanderChange(const ExpanderChangeEvent& e)
 {
-    noise = make_unique<OpenSimplexNoise::Noise>(seed);
+    updateChainHead(this);
 }
 
-void DaisyExpander::processIncomingMessage()
+void DaisyExpander::fromJson(json_t* rootJ)
 {
-    // ReSharper disable once CppReinterpretCastFromVoidPtr
-    auto* message = reinterpret_cast<Message*>(getLeftExpander().consumerMessage);
-    if (!message || message->processed)
-        return;
+    Module::fromJson(rootJ);
 
-    processSeed(message->seed);
+    // A preset may carry a different seed than the head's.
+    lastFrame = RESYNC_FRAME;
+}
 
-    if (message->globalReset) {
-        reset();
-    }
+bool DaisyExpander::isSameSampleDelivery() const
+{
+    return chainHead && chainHead->sameSampleDelivery;
+}
 
-    if (message->clockReceived)
-        onClock(message->clock);
+int DaisyExpander::getChainPosition() const
+{
+    return chainHead ? chainPosition : 0;
+}
 
-    message->processed = true;
+int DaisyExpander::getChainLength() const
+{
+    return chainHead ? chainHead->chainLength : 0;
+}
 
-    propagateToDaisyChained(*message);
+uint32_t DaisyExpander::getTopologyVersion() const
+{
+    return topologyVersion;
 }
 
-void DaisyExpander::propagateToDaisyChained(const Message& message)
+float DaisyExpander::getSamplesPerTick() const
 {
-    Module* rightModule = getRightExpander().module;
-    if (!isExpanderCompatible(rightModule))
-        return;
+    return samplesPerTick;
+}
 
-    // ReSharper disable once CppReinterpretCastFromVoidPtr
-    auto* producerMessage = reinterpret_cast<Message*>(rightModule->getLeftExpander().producerMessage);
-    if (!producerMessage)
-        return;
+float DaisyExpander::getTickPhase(const int64_t frame) const
+{
+    if (samplesPerTick <= 0.f)
+        return 0.f;
 
-    *producerMessage = message;
-    producerMessage->processed = false;
+    const int64_t due = frame - (isSameSampleDelivery() ? 0 : chainPosition);
+    const double phase = (static_cast<double>(due) - tickTime) / samplesPerTick;
+    return static_cast<float>(std::min(std::max(phase, 0.0), 1.0));
+}
 
-    rightModule->getLeftExpander().requestMessageFlip();
+bool DaisyExpander::isSeeded() const
+{
+    return noiseTables != NoiseRegistry::defaultTables();
+}
+
+void DaisyExpander::reseedNoise(const int seed)
+{
+    // Release first: the registry only guarantees one free entry per user.
+    NoiseRegistry& registry = NoiseRegistry::instance();
+    registry.release(noiseTables);
+    noiseTables = registry.acquire(seed);
+    TYCHE_STATS_COUNT(countReseed());
+
+    noise = noiseTables->noise();
+    simdNoise = noiseTables->simdNoise();
+}
+
+void DaisyExpander::processEvents(const int64_t frame)
+{
+    const ChainEventQueue& events = chainHead->events;
+    const int64_t due = frame - (chainHead->sameSampleDelivery ? 0 : chainPosition);
+
+    if (frame != lastFrame + 1)
+        resync(due);
+    lastFrame = frame;
+
+    // Only reachable with a chain of hundreds of modules; see ChainEventQueue.
+    if (eventCursor < events.begin()) {
+        TYCHE_STATS_COUNT(countDropped(events.begin() - eventCursor));
+        eventCursor = events.begin();
+    }
+
+    const uint64_t end = events.end();
+    for (; eventCursor < end; eventCursor++) {
+        const ChainEvent& event = events.at(eventCursor);
+        if (event.frame > due)
+            break;
+
+        TYCHE_STATS_COUNT(countEvent(frame - event.frame));
+        processEvent(event);
+    }
+}
+
+void DaisyExpander::resync(const int64_t due)
+{
+    processSeed(chainHead->publishedSeed.load(std::memory_order_relaxed));
+
+    // Skip what was missed, but keep events that are still on their way.
+    const ChainEventQueue& events = chainHead->events;
+    eventCursor = events.end();
+    while (eventCursor > events.begin() && events.at(eventCursor - 1).frame >= due)
+        eventCursor--;
+}
+
+void DaisyExpander::processEvent(const ChainEvent& event)
+{
+    switch (event.type) {
+    case ChainEventType::SEED:
+        processSeed(event.seed);
+        break;
+    case ChainEventType::RESET:
+        reset();
+        break;
+    case ChainEventType::CLOCK:
+        tickTime = event.tickTime;
+        samplesPerTick = event.samplesPerTick;
+        onClock(event.clock);
+        break;
+    }
 }
 
 bool isExpanderCompatible(Module* module)
@@ -65,6 +150,39 @@ bool isExpanderCompatible(Module* module)
     return dynamic_cast<DaisyExpander*>(module) != nullptr;
 }
 
+void updateChainHead(Module* module)
+{
+    Module* first = module;
+    while (isExpanderCompatible(first->getLeftExpander().module))
+        first = first->getLeftExpander().module;
+
+    // module is either a member, so first is the leftmost member, or the head itself.
+    ChainHead* head = dynamic_cast<ChainHead*>(first);
+    if (head)
+        first = first->getRightExpander().module;
+    else
+        head = dynamic_cast<ChainHead*>(first->getLeftExpander().module);
+
+    // Only ever 0 for modules that were never in a chain.
+    static uint32_t lastVersion = 0;
+    if (++lastVersion == 0)
+        ++lastVersion;
+
+    int position = 1;
+    for (Module* member = first; isExpanderCompatible(member); member = member->getRightExpander().module) {
+        auto* expander = static_cast<DaisyExpander*>(member);
+        if (expander->chainHead != head || expander->chainPosition != position)
+            expander->lastFrame = DaisyExpander::RESYNC_FRAME;
+
+        expander->chainHead = head;
+        expander->chainPosition = position++;
+        expander->topologyVersion = lastVersion;
+    }
+
+    if (head)
+        head->chainLength = position - 1;
+}
+
 void DaisyExpander::reset() {}
 
 void DaisyExpander::onClock(uint32_t clock) {}
@@ -1,39 +1,106 @@
 #pragma once
 
 #include "plugin.hpp"
-#include "OpenSimplexNoise/OpenSimplexNoise.h"
+#include "ChainEvents.h"
+#include "ModuleStats.h"
+#include "NoiseRegistry.h"
 
-struct Message {
-    int seed = 0;
-    bool seedChanged = false;
+// Head of an expander chain (Omen). Members read the head's events; by default
+// the member at chain position N handles an event N frames after the head
+// detected it, as if it had been passed along one module per frame. With
+// same-sample delivery every member handles it on the frame it was detected.
+struct ChainHead {
+    virtual ~ChainHead() = default;
 
-    bool globalReset = false;
+    // Detects the clock, reset and seed change of the given frame and queues
+    // them in events. The detection runs once per frame however many members
+    // ask, and on whichever engine thread asks first.
+    virtual void publish(int64_t frame) = 0;
 
-    uint32_t clock = 0;
-    bool clockReceived = false;
-
-    bool processed = false;
-
-    Message() = default;
+    // Seed as of the last publish(), for members joining the chain.
+    std::atomic<int> publishedSeed{0};
+    // Members to the right of the head, kept up to date by updateChainHead().
+    int chainLength = 0;
+    ChainEventQueue events;
+    bool sameSampleDelivery = false;
 };
 
 struct DaisyExpander : Module
 {
-    std::unique_ptr<OpenSimplexNoise::Noise> noise;
-    Message messages[2] = {};
+    // Shared with every module on the same seed, see NoiseRegistry.
+    const OpenSimplexNoise::Noise* noise;
+    // Same seed as noise, for evaluating four points per call.
+    const SimdNoise* simdNoise;
+
+#ifdef TYCHE_STATS
+    // Counted from const helpers too.
+    mutable ModuleStats stats;
+#endif
 
     DaisyExpander();
-    ~DaisyExpander() override = default;
+    ~DaisyExpander() override;
 
     void process(const ProcessArgs& args) override;
+    void onExpanderChange(const ExpanderChangeEvent& e) override;
+    void fromJson(json_t* rootJ) override;
     void reseedNoise(int seed);
-    void processIncomingMessage();
-    void propagateToDaisyChained(const Message& message);
+    void processEvents(int64_t frame);
+    void processEvent(const ChainEvent& event);
+    bool isSameSampleDelivery() const;
+    // False until the module has been given a seed.
+    bool isSeeded() const;
 
+    // Where this module is in its chain: 1 next to the head, 0 without a head.
+    int getChainPosition() const;
+    // Members in this module's chain, 0 without a head.
+    int getChainLength() const;
+    // Changes whenever a module joins or leaves the run of adjacent members
+    // this module is in, head or not. Lets a member cache what it found next
+    // to it instead of looking again on every sample.
+    uint32_t getTopologyVersion() const;
+
+    // Omen's tempo estimate in samples per 24ppqn tick, as of the last clock
+    // event this module handled; 0 until Omen has one.
+    float getSamplesPerTick() const;
+    // How far frame is from the last handled tick towards the next, from 0 to
+    // 1. Delayed like this module's events, so the phase starts over when the
+    // module handles a tick. Holds at 1 if the next tick is late: ticks only
+    // ever come from clock events.
+    float getTickPhase(int64_t frame) const;
 
     virtual void reset();
     virtual void onClock(uint32_t clock);
     virtual void processSeed(int newSeed);
+
+private:
+    friend void updateChainHead(Module* module);
+
+    void resync(int64_t due);
+
+    const NoiseTables* noiseTables;
+    // Head of the chain this module is in, if any, and this module's distance
+    // from it. Kept up to date by updateChainHead().
+    ChainHead* chainHead = nullptr;
+    int chainPosition = 0;
+    uint32_t topologyVersion = 0;
+
+    // From the last clock event handled, see getTickPhase().
+    double tickTime = 0.0;
+    float samplesPerTick = 0.f;
+
+    // Next event to handle, and the frame it was last checked on. A frame that
+    // does not follow on from lastFrame (after joining a chain, being bypassed
+    // or loading a preset) makes the module catch up with the head's seed first.
+    uint64_t eventCursor = 0;
+    int64_t lastFrame = RESYNC_FRAME;
+
+    static constexpr int64_t RESYNC_FRAME = INT64_MIN;
 };
 
 bool isExpanderCompatible(Module* module);
+
+// Tells every member of the chain containing module (a member or the head)
+// which head it belongs to and at which position, and gives them all a new
+// topology version. Called on expander changes, which Rack delivers outside of
+// module processing, so the chain is never walked while it is processed.
+void updateChainHead(Module* module);
@@ -1,3 +1,4 @@
+#include "CounterRng.h"
 #include "DaisyExpander.h"
 #include "plugin.hpp"
 
@@ -25,17 +26,34 @@ struct Fate final : DaisyExpander {
 
 	enum HoldState { A, B, NONE };
 
-	HoldState holdState = NONE;
-	bool canProcessNewGate = true;
-
+	// Poly channels read the noise plane at x = variant + c * CHANNEL_SPREAD, as
+	// Tale's do, so every channel makes its own decisions.
+	static constexpr float CHANNEL_SPREAD = 256.f;
+	static constexpr int GROUPS = PORT_MAX_CHANNELS / 4;
+
+	// Channels are processed four at a time; each lane of these masks is one
+	// channel's state.
+	float_4 holdA[GROUPS] = {};
+	float_4 holdB[GROUPS] = {};
+	float_4 canProcessNewGate[GROUPS];
+	// Hold state last written to the outputs, as movemask(holdA) | movemask(holdB) << 4.
+	// A group's outputs are only touched when its state moves away from it.
+	int outputMasks[GROUPS];
+
+	int channels = 1;
 	bool latchMode = false;
 
 	int seed = 0;
 	double phase = 0;
 	float variant = 1.f;
 
+	// With the counter source every channel numbers its decisions since the
+	// last reset, and decision n is the n-th number of the channel's stream.
+	int randomSource = CounterRng::SIMPLEX;
+	uint32_t decisions[PORT_MAX_CHANNELS] = {};
+
 	dsp::SchmittTrigger resetTrigger;
-	dsp::SchmittTrigger inSchmitt;
+	dsp::TSchmittTrigger<float_4> inSchmitts[GROUPS];
 
 	dsp::ClockDivider variantChangeDivider;
 
@@ -50,9 +68,14 @@ struct Fate final : DaisyExpander {
 		configOutput(OUT_B_OUTPUT, "B");
 
 		variantChangeDivider.setDivision(16384);
+
+		for (int g = 0; g < GROUPS; g++)
+			canProcessNewGate[g] = float_4::mask();
+		invalidateOutputs();
 	}
 
 	void process(const ProcessArgs& args) override {
+		TYCHE_STATS_PROCESS(args);
 		DaisyExpander::process(args);
 
 		phase += args.sampleTime;
@@ -64,50 +87,138 @@ struct Fate final : DaisyExpander {
 		if (variant != newVariant && variantChangeDivider.process())
 			variant = newVariant;
 
-		inSchmitt.process(getInput(IN_INPUT).getVoltage(), 0.1f, 1.f);
+		const int newChannels = std::max(1, getInput(IN_INPUT).getChannels());
+		if (newChannels != channels)
+		{
+			channels = newChannels;
+			invalidateOutputs();
+		}
+		getOutput(OUT_A_OUTPUT).setChannels(channels);
+		getOutput(OUT_B_OUTPUT).setChannels(channels);
+
+		for (int c = 0; c < channels; c += 4)
+			processGroup(c / 4);
+	}
+
+	void processGroup(const int g)
+	{
+		const int c = g * 4;
+		inSchmitts[g].process(getInput(IN_INPUT).getVoltageSimd<float_4>(c), 0.1f, 1.f);
+		const float_4 gate = inSchmitts[g].isHigh();
 
-		const bool gate = inSchmitt.isHigh();
-		if (gate && canProcessNewGate)
+		const float_4 newGate = gate & canProcessNewGate[g];
+		if (simd::movemask(newGate))
 		{
-			const float bias = getBias();
-			const double noiseVal = noise->eval(variant, phase);
-			holdState = noiseVal >= bias ? A : B;
-			canProcessNewGate = false;
-		} else if (!gate)
+			const float_4 chooseA = decide(c, newGate);
+			holdA[g] = simd::ifelse(newGate, chooseA, holdA[g]);
+			holdB[g] = simd::ifelse(newGate, ~chooseA, holdB[g]);
+			canProcessNewGate[g] &= ~newGate;
+		}
+
+		if (!latchMode)
 		{
-			if (!latchMode)
-				holdState = NONE;
-			canProcessNewGate = true;
+			holdA[g] &= gate;
+			holdB[g] &= gate;
 		}
+		canProcessNewGate[g] |= ~gate;
 
-		switch (holdState)
+		const int outputMask = simd::movemask(holdA[g]) | simd::movemask(holdB[g]) << 4;
+		if (outputMask != outputMasks[g])
+			updateOutputs(g, outputMask);
+	}
+
+	// Lanes that go to A for a gate arriving on channels c to c + 3 now. Only the
+	// lanes in newGate are used.
+	float_4 decide(const int c, const float_4 newGate)
+	{
+		const float_4 bias = getBias(c);
+
+		if (randomSource == CounterRng::COUNTER)
+		{
+			const int newLanes = simd::movemask(newGate);
+			float_4 chooseA = float_4::zero();
+			for (int i = 0; i < 4; i++)
+			{
+				if (!(newLanes & 1 << i))
+					continue;
+				const float u = CounterRng::uniform(seed, CounterRng::stream(variant, c + i), decisions[c + i]++);
+				chooseA[i] = 2.f * u - 1.f >= bias[i] ? float_4::mask()[0] : 0.f;
+			}
+			return chooseA;
+		}
+
+		// A mono Fate decides in double precision exactly as it always has.
+		if (channels == 1)
 		{
-			case A:
-				getOutput(OUT_A_OUTPUT).setVoltage(10.f);
-				getOutput(OUT_B_OUTPUT).setVoltage(0.f);
-				break;
-			case B:
-				getOutput(OUT_A_OUTPUT).setVoltage(0.f);
-				getOutput(OUT_B_OUTPUT).setVoltage(10.f);
-				break;
-			case NONE:
-				getOutput(OUT_A_OUTPUT).setVoltage(0.f);
-				getOutput(OUT_B_OUTPUT).setVoltage(0.f);
-				break;
+			TYCHE_STATS_COUNT(countNoise(1));
+			return noise->eval(variant, phase) >= bias[0] ? float_4::mask() : float_4::zero();
 		}
+
+		double xs[4];
+		for (int i = 0; i < 4; i++)
+			xs[i] = variant + static_cast<float>(c + i) * CHANNEL_SPREAD;
+		const double ys[4] = {phase, phase, phase, phase};
+
+		TYCHE_STATS_COUNT(countNoise(4));
+		return simdNoise->eval(xs, ys) >= bias;
+	}
+
+	void updateOutputs(const int g, const int outputMask)
+	{
+		getOutput(OUT_A_OUTPUT).setVoltageSimd(simd::ifelse(holdA[g], 10.f, 0.f), g * 4);
+		getOutput(OUT_B_OUTPUT).setVoltageSimd(simd::ifelse(holdB[g], 10.f, 0.f), g * 4);
+		outputMasks[g] = outputMask;
+	}
+
+	// Makes every group write its outputs on the next sample.
+	void invalidateOutputs()
+	{
+		for (int g = 0; g < GROUPS; g++)
+			outputMasks[g] = -1;
+	}
+
+	void onUnBypass(const UnBypassEvent& e) override
+	{
+		invalidateOutputs();
 	}
 
-	float getBias()
+	float_4 getBias(const int c)
 	{
 		if (getInput(BIAS_INPUT).isConnected())
-			return rescale(getInput(BIAS_INPUT).getVoltage(), -5.f, 5.f, -1.f, 1.f);
+		{
+			// Same operations as rescale(v, -5.f, 5.f, -1.f, 1.f), lane by lane.
+			const float_4 v = getInput(BIAS_INPUT).getPolyVoltageSimd<float_4>(c);
+			return -1.f + (v + 5.f) / 10.f * 2.f;
+		}
 
 		return rescale(getParam(BIAS_PARAM).getValue(), 0.f, 100.f, -1.f, 1.f);
 	}
 
+	HoldState getHoldState(const int c) const
+	{
+		if (holdA[c / 4][c % 4] != 0.f)
+			return A;
+		if (holdB[c / 4][c % 4] != 0.f)
+			return B;
+		return NONE;
+	}
+
+	void setHoldState(const int c, const HoldState state)
+	{
+		holdA[c / 4][c % 4] = state == A ? float_4::mask()[0] : 0.f;
+		holdB[c / 4][c % 4] = state == B ? float_4::mask()[0] : 0.f;
+	}
+
+	void setCanProcessNewGate(const int c, const bool canProcess)
+	{
+		canProcessNewGate[c / 4][c % 4] = canProcess ? float_4::mask()[0] : 0.f;
+	}
+
 	void reset() override
 	{
 		phase = 0;
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+			decisions[c] = 0;
 	}
 
 	json_t* dataToJson() override
@@ -120,18 +231,37 @@ struct Fate final : DaisyExpander {
 		json_t* phaseJ = json_real(phase);
 		json_object_set_new(rootJ, "phase", phaseJ);
 
-		json_t* holdStateJ = json_integer(holdState);
+		// Channel 0 keeps the keys of a mono Fate; the arrays cover every channel.
+		json_t* holdStateJ = json_integer(getHoldState(0));
 		json_object_set_new(rootJ, "holdState", holdStateJ);
 
 		json_t* latchJ = json_boolean(latchMode);
 		json_object_set_new(rootJ, "latch", latchJ);
 
-		json_t* canProcessNewGateJ = json_boolean(canProcessNewGate);
+		json_t* canProcessNewGateJ = json_boolean(canProcessNewGate[0][0] != 0.f);
 		json_object_set_new(rootJ, "canProcessNewGate", canProcessNewGateJ);
 
+		json_t* holdStatesJ = json_array();
+		json_t* canProcessNewGatesJ = json_array();
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+		{
+			json_array_append_new(holdStatesJ, json_integer(getHoldState(c)));
+			json_array_append_new(canProcessNewGatesJ, json_boolean(canProcessNewGate[c / 4][c % 4] != 0.f));
+		}
+		json_object_set_new(rootJ, "holdStates", holdStatesJ);
+		json_object_set_new(rootJ, "canProcessNewGates", canProcessNewGatesJ);
+
 		json_t* seedJ = json_integer(seed);
 		json_object_set_new(rootJ, "seed", seedJ);
 
+		json_t* randomSourceJ = json_integer(randomSource);
+		json_object_set_new(rootJ, "randomSource", randomSourceJ);
+
+		json_t* decisionsJ = json_array();
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+			json_array_append_new(decisionsJ, json_integer(decisions[c]));
+		json_object_set_new(rootJ, "decisions", decisionsJ);
+
 		return rootJ;
 	}
 
@@ -147,7 +277,7 @@ struct Fate final : DaisyExpander {
 
 		const json_t* holdStateJ = json_object_get(rootJ, "holdState");
 		if (holdStateJ)
-			holdState = static_cast<HoldState>(json_integer_value(holdStateJ));
+			setHoldState(0, static_cast<HoldState>(json_integer_value(holdStateJ)));
 
 		const json_t* latchJ = json_object_get(rootJ, "latch");
 		if (latchJ)
@@ -155,13 +285,40 @@ struct Fate final : DaisyExpander {
 
 		const json_t* canProcessNewGateJ = json_object_get(rootJ, "canProcessNewGate");
 		if (canProcessNewGateJ)
-			canProcessNewGate = json_boolean_value(canProcessNewGateJ);
+			setCanProcessNewGate(0, json_boolean_value(canProcessNewGateJ));
+
+		// Patches saved before poly support only carry channel 0.
+		const json_t* holdStatesJ = json_object_get(rootJ, "holdStates");
+		const json_t* canProcessNewGatesJ = json_object_get(rootJ, "canProcessNewGates");
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+		{
+			const json_t* stateJ = json_array_get(holdStatesJ, c);
+			if (stateJ)
+				setHoldState(c, static_cast<HoldState>(json_integer_value(stateJ)));
+
+			const json_t* canProcessJ = json_array_get(canProcessNewGatesJ, c);
+			if (canProcessJ)
+				setCanProcessNewGate(c, json_boolean_value(canProcessJ));
+		}
+		invalidateOutputs();
 
 		const json_t* seedJ = json_object_get(rootJ, "seed");
 		if (seedJ) {
 			seed = static_cast<int>(json_integer_value(seedJ));
 			reseedNoise(seed);
 		}
+
+		const json_t* randomSourceJ = json_object_get(rootJ, "randomSource");
+		if (randomSourceJ)
+			randomSource = clamp(static_cast<int>(json_integer_value(randomSourceJ)), 0, CounterRng::SOURCES_LEN - 1);
+
+		const json_t* decisionsJ = json_object_get(rootJ, "decisions");
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+		{
+			const json_t* decisionJ = json_array_get(decisionsJ, c);
+			if (decisionJ)
+				decisions[c] = static_cast<uint32_t>(json_integer_value(decisionJ));
+		}
 	}
 
 	void processSeed(int newSeed) override {
@@ -201,6 +358,11 @@ struct FateWidget final : ModuleWidget {
 
 		menu->addChild(new MenuSeparator());
 		menu->addChild(createBoolPtrMenuItem("Latch mode", "", &module->latchMode));
+		menu->addChild(createIndexPtrSubmenuItem("Randomness", {"Simplex noise", "Counter (uniform)"}, &module->randomSource));
+
+#ifdef TYCHE_STATS
+		appendStatsMenu(menu, module->stats);
+#endif
 	}
 };
 
@@ -0,0 +1,356 @@
+#include "plugin.hpp"
+#include "DaisyExpander.h"
+
+
+// Eight Krons in one module. All lanes share one clock and decide together on
+// each tick, so a lane can be muted by any lane above it on the same sample.
+struct Horae final : DaisyExpander {
+	static constexpr int LANES = 8;
+	// No lane mutes this one.
+	static constexpr int NO_MUTE = -1;
+
+	enum ParamId {
+		ENUMS(DENSITY_PARAM, LANES),
+		ENUMS(VARIANT_PARAM, LANES),
+		PARAMS_LEN
+	};
+	enum InputId {
+		ENUMS(DENSITY_INPUT, LANES),
+		RESET_INPUT,
+		INPUTS_LEN
+	};
+	enum OutputId {
+		ENUMS(OUT_OUTPUT, LANES),
+		OUTPUTS_LEN
+	};
+	enum LightId {
+		ENUMS(DENSITY_LIGHT, LANES * 3),
+		LIGHTS_LEN
+	};
+
+	enum class LaneState { IDLE, TRIGGERED, MUTED };
+
+	// Same divisions and defaults as Kron. A lane follows the same noise as a
+	// Kron with the same settings, but evaluates it in single precision and
+	// takes variant changes on the next tick, so the two can differ where the
+	// noise sits right at the density threshold.
+	const std::array<uint32_t, 12> divisionMapping = {
+		48, // 1/2
+		32, // 1/2t
+		72, // 1/2.
+		24, // 1/4
+		16, // 1/4t
+		36, // 1/4.
+		12, // 1/8
+		8,  // 1/8t
+		18, // 1/8.
+		6,  // 1/16
+		4,  // 1/16t
+		9   // 1/16.
+	};
+
+	std::array<int, LANES> divisionIdx;
+	// Lane whose trigger mutes this one, always above it, or NO_MUTE.
+	std::array<int, LANES> muteSourceIdx;
+
+	int seed = 0;
+	uint32_t globalClock = 0;
+	uint32_t localClock = 0;
+
+	bool clockProcessed = true;
+
+	dsp::SchmittTrigger resetTrigger;
+	dsp::PulseGenerator pulses[LANES];
+	// Lanes whose output still has to follow their pulse, one bit per lane.
+	uint32_t pulsesActive = 0;
+
+	std::array<LaneState, LANES> laneStates;
+	dsp::ClockDivider lightDivider;
+
+	Horae() {
+		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		for (int i = 0; i < LANES; i++)
+		{
+			const std::string lane = "Lane " + std::to_string(i + 1);
+			configParam(DENSITY_PARAM + i, 0.f, 100.f, 50.f, lane + " density", "%");
+			configParam(VARIANT_PARAM + i, 1.f, 128.f, static_cast<float>(i + 1), lane + " variant");
+			configInput(DENSITY_INPUT + i, lane + " density");
+			configOutput(OUT_OUTPUT + i, lane + " trigger");
+		}
+		configInput(RESET_INPUT, "Reset");
+
+		divisionIdx.fill(6);
+		muteSourceIdx.fill(NO_MUTE);
+		laneStates.fill(LaneState::IDLE);
+		lightDivider.setDivision(256);
+	}
+
+	void process(const ProcessArgs& args) override {
+		TYCHE_STATS_PROCESS(args);
+		handleReset();
+		DaisyExpander::process(args);
+
+		if (!clockProcessed)
+		{
+			processTick();
+			clockProcessed = true;
+		}
+
+		if (lightDivider.process())
+			updateLights(args.sampleTime * lightDivider.getDivision());
+
+		if (pulsesActive)
+		{
+			for (int i = 0; i < LANES; i++)
+			{
+				const uint32_t bit = 1u << i;
+				if (!(pulsesActive & bit))
+					continue;
+
+				const bool high = pulses[i].process(args.sampleTime);
+				if (!high)
+					pulsesActive &= ~bit;
+				getOutput(OUT_OUTPUT + i).setVoltage(high ? 10.f : 0.f);
+			}
+		}
+	}
+
+	// Decides every lane due on this tick in one go: the noise for all lanes is
+	// evaluated together, then the lanes are resolved top to bottom so a lane
+	// sees whether its mute source fired on this very sample.
+	void processTick()
+	{
+		uint32_t due = 0;
+		for (int i = 0; i < LANES; i++)
+		{
+			if (localClock % divisionMapping[divisionIdx[i]] == 0)
+				due |= 1u << i;
+		}
+		if (!due)
+			return;
+
+		double variants[LANES];
+		double clocks[LANES];
+		for (int i = 0; i < LANES; i++)
+		{
+			variants[i] = getParam(VARIANT_PARAM + i).getValue();
+			clocks[i] = localClock;
+		}
+
+		float noiseVals[LANES];
+		for (int i = 0; i < LANES; i += 4)
+		{
+			TYCHE_STATS_COUNT(countNoise(4));
+			const float_4 values = simdNoise->eval(&variants[i], &clocks[i]);
+			values.store(&noiseVals[i]);
+		}
+
+		uint32_t fired = 0;
+		for (int i = 0; i < LANES; i++)
+		{
+			const uint32_t bit = 1u << i;
+			if (!(due & bit))
+				continue;
+
+			if (getDensity(i) < rescale(noiseVals[i], -1.f, 1.f, 0.f, 100.f))
+				continue;
+
+			const int muteSource = muteSourceIdx[i];
+			if (muteSource != NO_MUTE && (fired & (1u << muteSource)))
+			{
+				laneStates[i] = LaneState::MUTED;
+				continue;
+			}
+
+			fired |= bit;
+			laneStates[i] = LaneState::TRIGGERED;
+			pulses[i].trigger(1e-3f);
+		}
+
+		pulsesActive |= fired;
+	}
+
+	float getDensity(const int lane)
+	{
+		float densityFactor = getParam(DENSITY_PARAM + lane).getValue();
+		densityFactor = rescale(densityFactor, 0.f, 100.f, 0.f, 1.f);
+
+		float maxDensity = 100.f;
+		if (getInput(DENSITY_INPUT + lane).isConnected())
+		{
+			const float d = getInput(DENSITY_INPUT + lane).getVoltage();
+			maxDensity = rescale(d, -5.f, 5.f, 0.f, 100.f);
+		}
+
+		return maxDensity * densityFactor;
+	}
+
+	void handleReset()
+	{
+		const float resetIn = getInput(RESET_INPUT).getVoltage();
+		if (resetTrigger.process(resetIn, 0.1f, 2.f))
+			reset();
+	}
+
+	void onClock(const uint32_t clock) override
+	{
+		clockProcessed = false;
+
+		const uint32_t delta = clock - globalClock;
+		if (delta > 0) {
+			globalClock = clock;
+			localClock += delta;
+		} else {
+			globalClock = clock;
+			localClock = clock;
+		}
+
+		// Local clock cannot be greater than the global clock.
+		if (localClock > globalClock)
+			localClock = globalClock;
+	}
+
+	void reset() override {
+		localClock = -1;
+		for (int i = 0; i < LANES; i++)
+			pulses[i].reset();
+		pulsesActive = (1u << LANES) - 1;
+	}
+
+	void onUnBypass(const UnBypassEvent& e) override {
+		pulsesActive = (1u << LANES) - 1;
+	}
+
+	// Shows each lane's decisions since the last update, then lets the light fade
+	// until the lane decides again.
+	void updateLights(const float delta)
+	{
+		for (int i = 0; i < LANES; i++)
+		{
+			const int light = DENSITY_LIGHT + i * 3;
+			const LaneState state = laneStates[i];
+			getLight(light + 0).setBrightnessSmooth(state != LaneState::IDLE ? 1.f : 0.f, delta);
+			getLight(light + 1).setBrightnessSmooth(state == LaneState::TRIGGERED ? 1.f : 0.f, delta);
+			getLight(light + 2).setBrightnessSmooth(0.f, delta);
+			laneStates[i] = LaneState::IDLE;
+		}
+	}
+
+	json_t* dataToJson() override
+	{
+		json_t* rootJ = json_object();
+
+		json_t* divisionIdxJ = json_array();
+		json_t* muteSourceIdxJ = json_array();
+		for (int i = 0; i < LANES; i++)
+		{
+			json_array_append_new(divisionIdxJ, json_integer(divisionIdx[i]));
+			json_array_append_new(muteSourceIdxJ, json_integer(muteSourceIdx[i]));
+		}
+		json_object_set_new(rootJ, "divisionIdx", divisionIdxJ);
+		json_object_set_new(rootJ, "muteSourceIdx", muteSourceIdxJ);
+
+		json_t* seedJ = json_integer(seed);
+		json_object_set_new(rootJ, "seed", seedJ);
+
+		json_t* localClockJ = json_integer(localClock);
+		json_object_set_new(rootJ, "localClock", localClockJ);
+
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override
+	{
+		const json_t* divisionIdxJ = json_object_get(rootJ, "divisionIdx");
+		const json_t* muteSourceIdxJ = json_object_get(rootJ, "muteSourceIdx");
+		for (int i = 0; i < LANES; i++)
+		{
+			const json_t* divisionJ = json_array_get(divisionIdxJ, i);
+			if (divisionJ)
+				divisionIdx[i] = clamp(static_cast<int>(json_integer_value(divisionJ)), 0, static_cast<int>(divisionMapping.size()) - 1);
+
+			// Only a lane above can mute, so the lanes resolve in one pass.
+			const json_t* muteSourceJ = json_array_get(muteSourceIdxJ, i);
+			if (muteSourceJ)
+				muteSourceIdx[i] = clamp(static_cast<int>(json_integer_value(muteSourceJ)), NO_MUTE, i - 1);
+		}
+
+		const json_t* seedJ = json_object_get(rootJ, "seed");
+		if (seedJ) {
+			seed = static_cast<int>(json_integer_value(seedJ));
+			reseedNoise(seed);
+		}
+
+		const json_t* localClockJ = json_object_get(rootJ, "localClock");
+		if (localClockJ)
+			localClock = static_cast<uint32_t>(json_integer_value(localClockJ));
+	}
+
+	void processSeed(int newSeed) override {
+		if (seed != newSeed) {
+			seed = newSeed;
+			reseedNoise(seed);
+		}
+	}
+};
+
+
+struct HoraeSnapKnob final : RoundSmallBlackKnob {
+	HoraeSnapKnob() {
+		snap = true;
+	}
+};
+
+
+struct HoraeWidget final : ModuleWidget {
+	explicit HoraeWidget(Horae* module) {
+		setModule(module);
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/Horae.svg")));
+
+		for (int i = 0; i < Horae::LANES; i++)
+		{
+			const float y = 20.f + 12.f * i;
+			addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(6.5, y)), module, Horae::DENSITY_PARAM + i));
+			addChild(createLightCentered<SmallLight<RedGreenBlueLight>>(mm2px(Vec(10.5, y - 4.f)), module, Horae::DENSITY_LIGHT + i * 3));
+			addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(15.5, y)), module, Horae::DENSITY_INPUT + i));
+			addParam(createParamCentered<HoraeSnapKnob>(mm2px(Vec(24.5, y)), module, Horae::VARIANT_PARAM + i));
+			addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(34.5, y)), module, Horae::OUT_OUTPUT + i));
+		}
+
+		addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(15.5, 118)), module, Horae::RESET_INPUT));
+	}
+
+	void appendContextMenu(ui::Menu* menu) override
+	{
+		Horae* module = getModule<Horae>();
+
+		menu->addChild(new MenuSeparator());
+		for (int i = 0; i < Horae::LANES; i++)
+		{
+			const std::string lane = "Lane " + std::to_string(i + 1);
+			menu->addChild(createSubmenuItem(lane, "", [=](ui::Menu* laneMenu) {
+				laneMenu->addChild(createIndexPtrSubmenuItem("Division", {"1/2", "1/2t", "1/2.", "1/4", "1/4t", "1/4.", "1/8", "1/8t", "1/8.", "1/16", "1/16t", "1/16."}, &module->divisionIdx[i]));
+
+				if (i == 0)
+					return;
+
+				// Only lanes above can mute, so every lane is decided in one pass.
+				std::vector<std::string> sources = {"None"};
+				for (int j = 0; j < i; j++)
+					sources.push_back("Lane " + std::to_string(j + 1));
+
+				laneMenu->addChild(createIndexSubmenuItem("Muted by", sources,
+					[=]() { return static_cast<size_t>(module->muteSourceIdx[i] + 1); },
+					[=](size_t source) { module->muteSourceIdx[i] = static_cast<int>(source) - 1; }
+				));
+			}));
+		}
+
+#ifdef TYCHE_STATS
+		appendStatsMenu(menu, module->stats);
+#endif
+	}
+};
+
+
+Model* modelHorae = createModel<Horae, HoraeWidget>("Horae");
@@ -1,4 +1,7 @@
+#include <bitset>
+
 #include "plugin.hpp"
+#include "CounterRng.h"
 #include "DaisyExpander.h"
 
 
@@ -26,19 +29,36 @@ struct Kron final : DaisyExpander {
 		LIGHTS_LEN
 	};
 
+	static constexpr int DIVISIONS = 12;
+	// In poly mode the division at divisionMapping[d] reads the noise plane at
+	// x = variant + d * DIVISION_SPREAD, far enough apart that no two divisions
+	// or variants share a pattern.
+	static constexpr float DIVISION_SPREAD = 256.f;
+
 	uint32_t division = 12;
 	int divisionIdx = 6;
 
+	// Poly mode outputs one channel per division selected in polyDivisions (bit d
+	// for divisionMapping[d]), in divisionMapping order.
+	bool polyMode = false;
+	uint32_t polyDivisions = (1u << DIVISIONS) - 1;
+	int polyChannels = 0;
+	int polyChannelDivisions[DIVISIONS] = {};
+
 	float variant = 1;
 	dsp::ClockDivider variantChangeDivider;
 
+	// Counter decisions are one per tick, keyed by the clock.
+	int randomSource = CounterRng::SIMPLEX;
+
 	int seed = 0;
 	uint32_t globalClock = 0;
 	uint32_t localClock = 0;
 
 	bool clockProcessed = true;
+	bool tickDeferred = false;
 
-	const std::array<uint32_t, 12> divisionMapping = {
+	const std::array<uint32_t, DIVISIONS> divisionMapping = {
 		48, // 1/2
 		32, // 1/2t
 		72, // 1/2.
@@ -55,6 +75,39 @@ struct Kron final : DaisyExpander {
 
 	dsp::SchmittTrigger resetTrigger;
 	dsp::PulseGenerator pulse;
+	// True while the output still has to follow the pulse, including the sample it falls.
+	bool pulseActive = false;
+	// Poly mode: one pulse per channel, and a bit per channel still following it.
+	dsp::PulseGenerator polyPulses[DIVISIONS];
+	uint32_t polyPulsesActive = 0;
+
+	dsp::ClockDivider lightDivider;
+
+	// The decisions of the current bar, worked out when the bar starts or its
+	// inputs change, so a tick only tests a bit. barNoise holds the noise of
+	// every tick due in the bar; barFires is re-derived from it when the density
+	// moves, without evaluating the noise again.
+	static constexpr uint32_t TICKS_PER_BAR = 96;
+	static constexpr uint32_t NO_BAR = UINT32_MAX;
+
+	uint32_t barStart = NO_BAR;
+	float barVariant = 0.f;
+	int barDivisionIdx = 0;
+	int barSeed = 0;
+	int barRandomSource = CounterRng::SIMPLEX;
+	float barDensity = -1.f;
+	float barNoise[TICKS_PER_BAR] = {};
+	std::bitset<TICKS_PER_BAR> barDue;
+	std::bitset<TICKS_PER_BAR> barFires;
+
+	// Snapshot of the bar for the pattern display, written by the audio thread
+	// only. A read is consistent if patternGeneration is even and unchanged
+	// across it.
+	static constexpr int PATTERN_WORDS = TICKS_PER_BAR / 32;
+	std::atomic<uint32_t> patternGeneration{0};
+	std::atomic<uint32_t> patternDue[PATTERN_WORDS] = {};
+	std::atomic<uint32_t> patternFires[PATTERN_WORDS] = {};
+	std::atomic<int> patternPosition{-1};
 
 	Kron() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -66,42 +119,322 @@ struct Kron final : DaisyExpander {
 		configOutput(OUT_OUTPUT, "Trigger");
 
 		variantChangeDivider.setDivision(16384);
+		lightDivider.setDivision(256);
 	}
 
 	void process(const ProcessArgs& args) override {
+		TYCHE_STATS_PROCESS(args);
 		handleReset();
 		DaisyExpander::process(args);
 		handleVariantChange();
+
+		// Everything below the tick only matters on the sample a clock arrives.
+		if (!clockProcessed)
+		{
+			// With same-sample delivery a muting Kron triggers on the same sample as
+			// this one, and its output only arrives here one sample later. Wait for it.
+			if (!tickDeferred && isSameSampleDelivery() && getInput(MUTE_INPUT).isConnected())
+			{
+				tickDeferred = true;
+			}
+			else
+			{
+				processTick(args.sampleTime);
+				clockProcessed = true;
+				tickDeferred = false;
+			}
+		}
+
+		if (lightDivider.process())
+			setLight(DENSITY_LIGHT, LightColor::OFF, args.sampleTime * lightDivider.getDivision());
+
+		if (pulseActive)
+		{
+			pulseActive = pulse.process(args.sampleTime);
+			getOutput(OUT_OUTPUT).setVoltage(pulseActive ? 10.f : 0.f);
+		}
+
+		if (polyPulsesActive)
+			processPolyPulses(args.sampleTime);
+	}
+
+	void processTick(const float sampleTime)
+	{
+		if (polyMode)
+		{
+			if (barStart != NO_BAR)
+				clearBar();
+			processPolyTick(sampleTime);
+			return;
+		}
+		if (polyChannels)
+			leavePolyMode();
+
 		division = divisionMapping[divisionIdx];
+		if (localClock % division != 0)
+			return;
+
+		updateBar();
+		const float density = getDensity();
+		if (density != barDensity)
+			updateBarFires(density);
+
+		const uint32_t tick = localClock - barStart;
+		publishPattern(static_cast<int>(tick));
+		if (!barFires[tick])
+			return;
 
-		const bool clockDivisionTriggered = localClock % division == 0;
 		const bool isBlocked = getInput(MUTE_INPUT).getVoltage() >= 0.1f;
+		if (isBlocked)
+		{
+			setLight(DENSITY_LIGHT, LightColor::RED, sampleTime);
+			return;
+		}
 
-		const float noiseVal = rescale(noise->eval(variant, localClock), -1.f, 1.f, 0.f, 100.f);
+		pulse.trigger(1e-3f);
+		pulseActive = true;
+		setLight(DENSITY_LIGHT, LightColor::YELLOW, sampleTime);
+	}
 
-		const float density = getDensity();
-		bool noiseGate = false;
-		if (density >= noiseVal)
-			noiseGate = true;
+	// Evaluates the noise of the bar localClock is in, unless it is already known
+	// for this variant, division, seed and source.
+	void updateBar()
+	{
+		const uint32_t start = localClock - localClock % TICKS_PER_BAR;
+		if (start == barStart && variant == barVariant && divisionIdx == barDivisionIdx && seed == barSeed && randomSource == barRandomSource)
+			return;
+
+		barStart = start;
+		barVariant = variant;
+		barDivisionIdx = divisionIdx;
+		barSeed = seed;
+		barRandomSource = randomSource;
+		barDue.reset();
+		for (uint32_t tick = (division - start % division) % division; tick < TICKS_PER_BAR; tick += division)
+		{
+			barDue.set(tick);
+			if (randomSource == CounterRng::COUNTER)
+			{
+				barNoise[tick] = 100.f * CounterRng::uniform(seed, CounterRng::stream(variant, 0), start + tick);
+				continue;
+			}
+
+			TYCHE_STATS_COUNT(countNoise(1));
+			barNoise[tick] = rescale(noise->eval(variant, start + tick), -1.f, 1.f, 0.f, 100.f);
+		}
+
+		// Forces the fires to be derived again.
+		barDensity = -1.f;
+	}
 
-		if (!clockProcessed && clockDivisionTriggered && noiseGate && !isBlocked)
+	void updateBarFires(const float density)
+	{
+		barDensity = density;
+		barFires.reset();
+		for (uint32_t tick = 0; tick < TICKS_PER_BAR; tick++)
 		{
-			pulse.trigger(1e-3f);
-			setLight(DENSITY_LIGHT, LightColor::YELLOW, args.sampleTime);
-		} else if (!clockProcessed && clockDivisionTriggered && noiseGate && isBlocked)
+			if (barDue[tick] && density >= barNoise[tick])
+				barFires.set(tick);
+		}
+	}
+
+	void clearBar()
+	{
+		barStart = NO_BAR;
+		barDue.reset();
+		barFires.reset();
+		publishPattern(-1);
+	}
+
+	void publishPattern(const int position)
+	{
+		const uint32_t generation = patternGeneration.load(std::memory_order_relaxed);
+		patternGeneration.store(generation + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (int w = 0; w < PATTERN_WORDS; w++)
 		{
-			setLight(DENSITY_LIGHT, LightColor::RED, args.sampleTime);
-		} else
+			patternDue[w].store(bitsToWord(barDue, w), std::memory_order_relaxed);
+			patternFires[w].store(bitsToWord(barFires, w), std::memory_order_relaxed);
+		}
+		patternPosition.store(position, std::memory_order_relaxed);
+
+		patternGeneration.store(generation + 2, std::memory_order_release);
+	}
+
+	static uint32_t bitsToWord(const std::bitset<TICKS_PER_BAR>& bits, const int word)
+	{
+		return static_cast<uint32_t>(((bits >> (word * 32)) & std::bitset<TICKS_PER_BAR>(UINT32_MAX)).to_ulong());
+	}
+
+	// UI thread. Copies the last published bar; position is -1 before the first
+	// tick and in poly mode.
+	void readPattern(std::bitset<TICKS_PER_BAR>& due, std::bitset<TICKS_PER_BAR>& fires, int& position) const
+	{
+		uint32_t generation;
+		uint32_t dueWords[PATTERN_WORDS];
+		uint32_t firesWords[PATTERN_WORDS];
+		do {
+			generation = patternGeneration.load(std::memory_order_acquire);
+			for (int w = 0; w < PATTERN_WORDS; w++)
+			{
+				dueWords[w] = patternDue[w].load(std::memory_order_relaxed);
+				firesWords[w] = patternFires[w].load(std::memory_order_relaxed);
+			}
+			position = patternPosition.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while ((generation & 1) || generation != patternGeneration.load(std::memory_order_relaxed));
+
+		due.reset();
+		fires.reset();
+		for (int w = PATTERN_WORDS - 1; w >= 0; w--)
+		{
+			due = (due << 32) | std::bitset<TICKS_PER_BAR>(dueWords[w]);
+			fires = (fires << 32) | std::bitset<TICKS_PER_BAR>(firesWords[w]);
+		}
+	}
+
+	// Decides every poly channel due on this tick. The noise for all of them is
+	// evaluated in one batch, four channels per call.
+	void processPolyTick(const float sampleTime)
+	{
+		updatePolyChannels();
+
+		int dueChannels[DIVISIONS];
+		double xs[DIVISIONS];
+		double ys[DIVISIONS];
+		int due = 0;
+		for (int c = 0; c < polyChannels; c++)
 		{
-			setLight(DENSITY_LIGHT, LightColor::OFF, args.sampleTime);
+			const int d = polyChannelDivisions[c];
+			if (localClock % divisionMapping[d] != 0)
+				continue;
+
+			dueChannels[due] = c;
+			xs[due] = variant + d * DIVISION_SPREAD;
+			ys[due] = localClock;
+			due++;
 		}
+		if (due == 0)
+			return;
 
-		clockProcessed = true;
+		float thresholds[DIVISIONS];
+		getPolyThresholds(due, dueChannels, xs, ys, thresholds);
 
-		getOutput(OUT_OUTPUT).setVoltage(pulse.process(args.sampleTime) ? 10.f : 0.f);
+		bool triggered = false;
+		bool blocked = false;
+		for (int i = 0; i < due; i++)
+		{
+			const int c = dueChannels[i];
+			if (getDensity(c) < thresholds[i])
+				continue;
+
+			if (getInput(MUTE_INPUT).getPolyVoltage(c) >= 0.1f)
+			{
+				blocked = true;
+				continue;
+			}
+
+			polyPulses[c].trigger(1e-3f);
+			polyPulsesActive |= 1u << c;
+			triggered = true;
+		}
+
+		if (triggered)
+			setLight(DENSITY_LIGHT, LightColor::YELLOW, sampleTime);
+		else if (blocked)
+			setLight(DENSITY_LIGHT, LightColor::RED, sampleTime);
 	}
 
-	float getDensity()
+	// Density each due channel has to reach to fire, from the noise at xs and ys
+	// or from the counter generator.
+	void getPolyThresholds(const int due, const int* dueChannels, double* xs, double* ys, float* thresholds)
+	{
+		if (randomSource == CounterRng::COUNTER)
+		{
+			for (int i = 0; i < due; i++)
+			{
+				const uint32_t stream = CounterRng::stream(variant, polyChannelDivisions[dueChannels[i]]);
+				thresholds[i] = 100.f * CounterRng::uniform(seed, stream, localClock);
+			}
+			return;
+		}
+
+		// Pad the last batch with a copy of the first point; its result is unused.
+		for (int i = due; i % 4 != 0; i++)
+		{
+			xs[i] = xs[0];
+			ys[i] = ys[0];
+		}
+
+		float noiseVals[DIVISIONS];
+		for (int i = 0; i < due; i += 4)
+		{
+			TYCHE_STATS_COUNT(countNoise(4));
+			simdNoise->eval(&xs[i], &ys[i]).store(&noiseVals[i]);
+		}
+
+		for (int i = 0; i < due; i++)
+			thresholds[i] = rescale(noiseVals[i], -1.f, 1.f, 0.f, 100.f);
+	}
+
+	void processPolyPulses(const float sampleTime)
+	{
+		for (int c = 0; c < polyChannels; c++)
+		{
+			const uint32_t bit = 1u << c;
+			if (!(polyPulsesActive & bit))
+				continue;
+
+			const bool high = polyPulses[c].process(sampleTime);
+			if (!high)
+				polyPulsesActive &= ~bit;
+			getOutput(OUT_OUTPUT).setVoltage(high ? 10.f : 0.f, c);
+		}
+	}
+
+	// Maps channels to the selected divisions. Changing the selection restarts
+	// every channel's pulse, so no channel keeps the pulse of another division.
+	void updatePolyChannels()
+	{
+		int channels = 0;
+		for (int d = 0; d < DIVISIONS; d++)
+		{
+			if (polyDivisions & (1u << d))
+				polyChannelDivisions[channels++] = d;
+		}
+
+		if (channels != polyChannels)
+		{
+			clearPolyPulses();
+			polyChannels = channels;
+		}
+
+		// Rack ignores setChannels() on an unpatched output and sets one channel
+		// when a cable is attached, so the output is checked rather than trusted.
+		if (getOutput(OUT_OUTPUT).getChannels() != polyChannels)
+			getOutput(OUT_OUTPUT).setChannels(polyChannels);
+	}
+
+	void leavePolyMode()
+	{
+		clearPolyPulses();
+		polyChannels = 0;
+		if (getOutput(OUT_OUTPUT).getChannels() != 1)
+			getOutput(OUT_OUTPUT).setChannels(1);
+	}
+
+	void clearPolyPulses()
+	{
+		for (int c = 0; c < DIVISIONS; c++)
+		{
+			polyPulses[c].reset();
+			getOutput(OUT_OUTPUT).setVoltage(0.f, c);
+		}
+		polyPulsesActive = 0;
+	}
+
+	float getDensity(const int channel = 0)
 	{
 		float densityFactor = getParam(DENSITY_PARAM).getValue();
 		densityFactor = rescale(densityFactor, 0.f, 100.f, 0.f, 1.f);
@@ -109,7 +442,7 @@ struct Kron final : DaisyExpander {
 		float maxDensity = 100.f;
 		if (getInput(DENSITY_INPUT).isConnected())
 		{
-			const float d = getInput(DENSITY_INPUT).getVoltage();
+			const float d = getInput(DENSITY_INPUT).getPolyVoltage(channel);
 			maxDensity = rescale(d, -5.f, 5.f, 0.f, 100.f);
 		}
 
@@ -152,6 +485,15 @@ struct Kron final : DaisyExpander {
 	void reset() override {
 		localClock = -1;
 		pulse.reset();
+		pulseActive = true;
+		for (int c = 0; c < polyChannels; c++)
+			polyPulses[c].reset();
+		polyPulsesActive = (1u << polyChannels) - 1;
+	}
+
+	void onUnBypass(const UnBypassEvent& e) override {
+		pulseActive = true;
+		polyPulsesActive = (1u << polyChannels) - 1;
 	}
 
 	void setLight(const LightId lightIndex, const LightColor color, const float delta)
@@ -191,6 +533,15 @@ struct Kron final : DaisyExpander {
 		json_t* localClockJ = json_integer(localClock);
 		json_object_set_new(rootJ, "localClock", localClockJ);
 
+		json_t* polyModeJ = json_boolean(polyMode);
+		json_object_set_new(rootJ, "polyMode", polyModeJ);
+
+		json_t* polyDivisionsJ = json_integer(polyDivisions);
+		json_object_set_new(rootJ, "polyDivisions", polyDivisionsJ);
+
+		json_t* randomSourceJ = json_integer(randomSource);
+		json_object_set_new(rootJ, "randomSource", randomSourceJ);
+
 		return rootJ;
 	}
 
@@ -205,12 +556,30 @@ struct Kron final : DaisyExpander {
 			variant = static_cast<float>(json_integer_value(variantJ));
 
 		const json_t* seedJ = json_object_get(rootJ, "seed");
-		if (seedJ)
+		if (seedJ) {
 			seed = static_cast<int>(json_integer_value(seedJ));
+			reseedNoise(seed);
+		}
 
 		const json_t* localClockJ = json_object_get(rootJ, "localClock");
 		if (localClockJ)
 			localClock = static_cast<uint32_t>(json_integer_value(localClockJ));
+
+		const json_t* polyModeJ = json_object_get(rootJ, "polyMode");
+		if (polyModeJ)
+			polyMode = json_boolean_value(polyModeJ);
+
+		const json_t* polyDivisionsJ = json_object_get(rootJ, "polyDivisions");
+		if (polyDivisionsJ)
+		{
+			const uint32_t divisions = static_cast<uint32_t>(json_integer_value(polyDivisionsJ)) & ((1u << DIVISIONS) - 1);
+			if (divisions)
+				polyDivisions = divisions;
+		}
+
+		const json_t* randomSourceJ = json_object_get(rootJ, "randomSource");
+		if (randomSourceJ)
+			randomSource = clamp(static_cast<int>(json_integer_value(randomSourceJ)), 0, CounterRng::SOURCES_LEN - 1);
 	}
 
 	void processSeed(int newSeed) override {
@@ -229,6 +598,51 @@ struct RoundSmallBlackSnapKnob final : RoundSmallBlackKnob {
 };
 
 
+// The current bar's steps top to bottom: lit for triggers, dim for steps that
+// stay silent, with the step last played outlined. Reads the module's pattern
+// snapshot only.
+struct KronPatternDisplay final : TransparentWidget {
+	Kron* module = nullptr;
+
+	void drawLayer(const DrawArgs& args, const int layer) override
+	{
+		if (layer != 1 || !module)
+			return;
+
+		std::bitset<Kron::TICKS_PER_BAR> due;
+		std::bitset<Kron::TICKS_PER_BAR> fires;
+		int position;
+		module->readPattern(due, fires, position);
+
+		const size_t steps = due.count();
+		if (steps == 0)
+			return;
+
+		const float stepHeight = box.size.y / steps;
+		float y = 0.f;
+		for (int tick = 0; tick < static_cast<int>(Kron::TICKS_PER_BAR); tick++)
+		{
+			if (!due[tick])
+				continue;
+
+			nvgBeginPath(args.vg);
+			nvgRect(args.vg, 0.f, y + stepHeight * 0.1f, box.size.x, stepHeight * 0.8f);
+			nvgFillColor(args.vg, fires[tick] ? nvgRGB(0xff, 0xff, 0xf0) : nvgRGBA(0xff, 0xff, 0xf0, 0x30));
+			nvgFill(args.vg);
+
+			if (tick == position)
+			{
+				nvgStrokeColor(args.vg, nvgRGB(0xff, 0xd0, 0x00));
+				nvgStrokeWidth(args.vg, 1.f);
+				nvgStroke(args.vg);
+			}
+
+			y += stepHeight;
+		}
+	}
+};
+
+
 struct KronWidget final : ModuleWidget {
 	explicit KronWidget(Kron* module) {
 		setModule(module);
@@ -242,14 +656,42 @@ struct KronWidget final : ModuleWidget {
 		addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(7.62, 114.233)), module, Kron::RESET_INPUT));
 
 		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(7.647, 96.5)), module, Kron::OUT_OUTPUT));
+
+		KronPatternDisplay* display = createWidget<KronPatternDisplay>(mm2px(Vec(10.9, 10.5)));
+		display->box.size = mm2px(Vec(2.8, 27.0));
+		display->module = module;
+		addChild(display);
 	}
 
 	void appendContextMenu(ui::Menu* menu) override
 	{
 		Kron* module = getModule<Kron>();
 
+		const std::vector<std::string> divisionLabels = {"1/2", "1/2t", "1/2.", "1/4", "1/4t", "1/4.", "1/8", "1/8t", "1/8.", "1/16", "1/16t", "1/16."};
+
 		menu->addChild(new MenuSeparator());
-		menu->addChild(createIndexPtrSubmenuItem("Division", {"1/2", "1/2t", "1/2.", "1/4", "1/4t", "1/4.", "1/8", "1/8t", "1/8.", "1/16", "1/16t", "1/16."}, &module->divisionIdx));
+		menu->addChild(createIndexPtrSubmenuItem("Division", divisionLabels, &module->divisionIdx));
+		menu->addChild(createIndexPtrSubmenuItem("Randomness", {"Simplex noise", "Counter (uniform)"}, &module->randomSource));
+		menu->addChild(createBoolPtrMenuItem("Poly output (one channel per division)", "", &module->polyMode));
+		menu->addChild(createSubmenuItem("Poly divisions", "", [=](ui::Menu* divisionsMenu) {
+			for (int d = 0; d < Kron::DIVISIONS; d++)
+			{
+				const uint32_t bit = 1u << d;
+				divisionsMenu->addChild(createBoolMenuItem(divisionLabels[d], "",
+					[=]() { return (module->polyDivisions & bit) != 0; },
+					// At least one division stays selected.
+					[=](bool selected) {
+						const uint32_t divisions = selected ? module->polyDivisions | bit : module->polyDivisions & ~bit;
+						if (divisions)
+							module->polyDivisions = divisions;
+					}
+				));
+			}
+		}));
+
+#ifdef TYCHE_STATS
+		appendStatsMenu(menu, module->stats);
+#endif
 	}
 };
 
@@ -0,0 +1,274 @@
+#include "AliasTable.h"
+#include "DaisyExpander.h"
+#include "plugin.hpp"
+
+
+// Fate with eight weighted outputs: every gate goes to one of them.
+struct Lachesis final : DaisyExpander {
+	static constexpr int OUTCOMES = 8;
+	static constexpr int NONE = -1;
+
+	enum ParamId {
+		ENUMS(WEIGHT_PARAM, OUTCOMES),
+		VARIANT_PARAM,
+		PARAMS_LEN
+	};
+	enum InputId {
+		ENUMS(WEIGHT_INPUT, OUTCOMES),
+		IN_INPUT,
+		RESET_INPUT,
+		INPUTS_LEN
+	};
+	enum OutputId {
+		ENUMS(OUT_OUTPUT, OUTCOMES),
+		OUTPUTS_LEN
+	};
+	enum LightId {
+		ENUMS(WEIGHT_LIGHT, OUTCOMES),
+		LIGHTS_LEN
+	};
+
+	// Output the current gate goes to, or NONE.
+	int holdState = NONE;
+	// Last state written to the outputs; they are only touched when holdState moves away from it.
+	int outputState = NONE;
+	bool canProcessNewGate = true;
+
+	bool latchMode = false;
+
+	int seed = 0;
+	double phase = 0;
+	float variant = 1.f;
+
+	// Rebuilt only when a weight differs from the one it was built for.
+	AliasTable<OUTCOMES> aliasTable;
+	float tableWeights[OUTCOMES] = {};
+
+	dsp::SchmittTrigger resetTrigger;
+	dsp::SchmittTrigger inSchmitt;
+
+	dsp::ClockDivider variantChangeDivider;
+	dsp::ClockDivider lightDivider;
+
+	Lachesis() {
+		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		for (int i = 0; i < OUTCOMES; i++)
+		{
+			const std::string outcome = std::to_string(i + 1);
+			configParam(WEIGHT_PARAM + i, 0.f, 100.f, 50.f, outcome + " relative weight", "%");
+			configInput(WEIGHT_INPUT + i, outcome + " weight");
+			configOutput(OUT_OUTPUT + i, outcome);
+		}
+		configParam(VARIANT_PARAM, 1.f, 128.f, 1.f, "Variant");
+		configInput(IN_INPUT, "In");
+		configInput(RESET_INPUT, "Reset");
+
+		variantChangeDivider.setDivision(16384);
+		lightDivider.setDivision(512);
+		invalidateTable();
+	}
+
+	void process(const ProcessArgs& args) override {
+		TYCHE_STATS_PROCESS(args);
+		DaisyExpander::process(args);
+
+		phase += args.sampleTime;
+
+		if (resetTrigger.process(getInput(RESET_INPUT).getVoltage()))
+			reset();
+
+		const float newVariant = getParam(VARIANT_PARAM).getValue();
+		if (variant != newVariant && variantChangeDivider.process())
+			variant = newVariant;
+
+		inSchmitt.process(getInput(IN_INPUT).getVoltage(), 0.1f, 1.f);
+
+		const bool gate = inSchmitt.isHigh();
+		if (gate && canProcessNewGate)
+		{
+			updateTable();
+			TYCHE_STATS_COUNT(countNoise(1));
+			holdState = aliasTable.size > 0 ? aliasTable.sample(uniformFromNoise(noise->eval(variant, phase))) : NONE;
+			canProcessNewGate = false;
+		} else if (!gate)
+		{
+			if (!latchMode)
+				holdState = NONE;
+			canProcessNewGate = true;
+		}
+
+		if (holdState != outputState)
+			updateOutputs();
+
+		if (lightDivider.process())
+			updateLights(args.sampleTime * lightDivider.getDivision());
+	}
+
+	// Reads the weights and rebuilds the table if any of them moved.
+	void updateTable()
+	{
+		float weights[OUTCOMES];
+		bool changed = false;
+		for (int i = 0; i < OUTCOMES; i++)
+		{
+			weights[i] = getWeight(i);
+			changed |= weights[i] != tableWeights[i];
+		}
+		if (!changed)
+			return;
+
+		std::copy(weights, weights + OUTCOMES, tableWeights);
+		aliasTable.build(tableWeights, OUTCOMES);
+	}
+
+	void invalidateTable()
+	{
+		std::fill(tableWeights, tableWeights + OUTCOMES, -1.f);
+	}
+
+	float getWeight(const int i)
+	{
+		float weight = getParam(WEIGHT_PARAM + i).getValue();
+		if (getInput(WEIGHT_INPUT + i).isConnected())
+			weight *= rescale(getInput(WEIGHT_INPUT + i).getVoltage(), -5.f, 5.f, 0.f, 1.f);
+
+		return std::max(weight, 0.f);
+	}
+
+	void updateOutputs()
+	{
+		if (outputState != NONE)
+			getOutput(OUT_OUTPUT + outputState).setVoltage(0.f);
+		if (holdState != NONE)
+			getOutput(OUT_OUTPUT + holdState).setVoltage(10.f);
+
+		outputState = holdState;
+	}
+
+	// Brightness follows each output's share of the weights; the output holding
+	// the gate is fully lit.
+	void updateLights(const float delta)
+	{
+		updateTable();
+		for (int i = 0; i < OUTCOMES; i++)
+		{
+			const float brightness = i == holdState ? 1.f : aliasTable.probability(i);
+			getLight(WEIGHT_LIGHT + i).setBrightnessSmooth(brightness, delta);
+		}
+	}
+
+	void onUnBypass(const UnBypassEvent& e) override
+	{
+		for (int i = 0; i < OUTCOMES; i++)
+			getOutput(OUT_OUTPUT + i).setVoltage(0.f);
+		outputState = NONE;
+	}
+
+	void reset() override
+	{
+		phase = 0;
+	}
+
+	json_t* dataToJson() override
+	{
+		json_t* rootJ = json_object();
+
+		json_t* variantJ = json_real(variant);
+		json_object_set_new(rootJ, "variant", variantJ);
+
+		json_t* phaseJ = json_real(phase);
+		json_object_set_new(rootJ, "phase", phaseJ);
+
+		json_t* holdStateJ = json_integer(holdState);
+		json_object_set_new(rootJ, "holdState", holdStateJ);
+
+		json_t* latchJ = json_boolean(latchMode);
+		json_object_set_new(rootJ, "latch", latchJ);
+
+		json_t* canProcessNewGateJ = json_boolean(canProcessNewGate);
+		json_object_set_new(rootJ, "canProcessNewGate", canProcessNewGateJ);
+
+		json_t* seedJ = json_integer(seed);
+		json_object_set_new(rootJ, "seed", seedJ);
+
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override
+	{
+		const json_t* variantJ = json_object_get(rootJ, "variant");
+		if (variantJ)
+			variant = static_cast<float>(json_real_value(variantJ));
+
+		const json_t* phaseJ = json_object_get(rootJ, "phase");
+		if (phaseJ)
+			phase = json_real_value(phaseJ);
+
+		const json_t* holdStateJ = json_object_get(rootJ, "holdState");
+		if (holdStateJ)
+			holdState = clamp(static_cast<int>(json_integer_value(holdStateJ)), NONE, OUTCOMES - 1);
+
+		const json_t* latchJ = json_object_get(rootJ, "latch");
+		if (latchJ)
+			latchMode = json_boolean_value(latchJ);
+
+		const json_t* canProcessNewGateJ = json_object_get(rootJ, "canProcessNewGate");
+		if (canProcessNewGateJ)
+			canProcessNewGate = json_boolean_value(canProcessNewGateJ);
+
+		const json_t* seedJ = json_object_get(rootJ, "seed");
+		if (seedJ) {
+			seed = static_cast<int>(json_integer_value(seedJ));
+			reseedNoise(seed);
+		}
+	}
+
+	void processSeed(int newSeed) override {
+		if (seed != newSeed) {
+			seed = newSeed;
+			reseedNoise(seed);
+		}
+	}
+};
+
+
+struct LachesisSnapKnob final : RoundSmallBlackKnob {
+	LachesisSnapKnob() {
+		snap = true;
+	}
+};
+
+
+struct LachesisWidget final : ModuleWidget {
+	explicit LachesisWidget(Lachesis* module) {
+		setModule(module);
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/Lachesis.svg")));
+
+		addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(6.5, 18.0)), module, Lachesis::IN_INPUT));
+		addParam(createParamCentered<LachesisSnapKnob>(mm2px(Vec(15.24, 18.0)), module, Lachesis::VARIANT_PARAM));
+		addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(23.98, 18.0)), module, Lachesis::RESET_INPUT));
+
+		for (int i = 0; i < Lachesis::OUTCOMES; i++)
+		{
+			const float y = 32.f + 12.f * i;
+			addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(6.5, y)), module, Lachesis::WEIGHT_PARAM + i));
+			addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(10.5, y - 4.f)), module, Lachesis::WEIGHT_LIGHT + i));
+			addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(15.24, y)), module, Lachesis::WEIGHT_INPUT + i));
+			addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(23.98, y)), module, Lachesis::OUT_OUTPUT + i));
+		}
+	}
+
+	void appendContextMenu(ui::Menu* menu) override {
+		Lachesis* module = getModule<Lachesis>();
+
+		menu->addChild(new MenuSeparator());
+		menu->addChild(createBoolPtrMenuItem("Latch mode", "", &module->latchMode));
+
+#ifdef TYCHE_STATS
+		appendStatsMenu(menu, module->stats);
+#endif
+	}
+};
+
+
+Model* modelLachesis = createModel<Lachesis, LachesisWidget>("Lachesis");
@@ -0,0 +1,240 @@
+#include "LoopTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "OpenSimplexNoise/OpenSimplexNoise.h"
+
+namespace {
+
+void renderPoints(LoopTable& table, const OpenSimplexNoise::Noise& noise, const float channelSpread)
+{
+    const LoopTable::Key& key = table.key;
+    const int size = table.size;
+
+    // The last quarter of the loop fades into the walk just before its start,
+    // so the end meets the beginning. Smoothstep keeps the slope continuous
+    // where the fade begins and at the wrap.
+    const double fadeLength = key.length / 4.0;
+    const double fadeStart = key.length - fadeLength;
+
+    for (int c = 0; c < key.channels; c++) {
+        const double x = key.variant + static_cast<float>(c) * channelSpread;
+        float* channelPoints = &table.points[static_cast<size_t>(c) * size];
+
+        for (int i = 0; i < size; i++) {
+            const double phase = static_cast<double>(i) / LoopTable::POINTS_PER_UNIT;
+            double value = noise.eval(x, phase);
+
+            if (phase > fadeStart) {
+                const double t = (phase - fadeStart) / fadeLength;
+                const double weight = t * t * (3.0 - 2.0 * t);
+                value += (noise.eval(x, phase - key.length) - value) * weight;
+            }
+
+            channelPoints[i] = static_cast<float>(value);
+        }
+    }
+}
+
+} // namespace
+
+void LoopTable::render(const Key& newKey, const float channelSpread)
+{
+    key = newKey;
+    size = key.length * POINTS_PER_UNIT;
+    points.resize(static_cast<size_t>(size) * key.channels);
+
+    // Noise the module has, so the table matches its live walk: a module
+    // that was never given a seed plays a default-constructed Noise.
+    if (key.seeded)
+        renderPoints(*this, OpenSimplexNoise::Noise(key.seed), channelSpread);
+    else
+        renderPoints(*this, OpenSimplexNoise::Noise(), channelSpread);
+}
+
+// The background thread shared by all renderers. It only runs while at least
+// one renderer exists, and sleeps until a request comes in.
+class LoopTableWorker {
+public:
+    static LoopTableWorker& instance()
+    {
+        static LoopTableWorker worker;
+        return worker;
+    }
+
+    void add(LoopTableRenderer* renderer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        renderers.push_back(renderer);
+
+        if (!thread.joinable()) {
+            stopping = false;
+            thread = std::thread(&LoopTableWorker::run, this);
+        }
+    }
+
+    // Blocks while the worker is rendering for renderer, so it can be destroyed after.
+    void remove(LoopTableRenderer* renderer)
+    {
+        std::thread stopped;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            renderers.erase(std::remove(renderers.begin(), renderers.end(), renderer), renderers.end());
+            // The erase shifts the renderers a pass is going through, so one may be skipped.
+            workRequested.store(true, std::memory_order_relaxed);
+            rendered.wait(lock, [&] { return rendering != renderer; });
+
+            if (renderers.empty() && thread.joinable()) {
+                stopping = true;
+                stopped = std::move(thread);
+            }
+        }
+
+        if (stopped.joinable()) {
+            wakeUp.notify_one();
+            stopped.join();
+        }
+    }
+
+    // Called from the audio thread; neither call takes the mutex.
+    void wake()
+    {
+        workRequested.store(true, std::memory_order_release);
+        wakeUp.notify_one();
+    }
+
+private:
+    // Renders without holding the mutex, so add() and remove() only wait for
+    // the renderer being worked on, if it is theirs.
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            workRequested.store(false, std::memory_order_relaxed);
+
+            bool waiting = false;
+            for (size_t i = 0; i < renderers.size(); i++) {
+                LoopTableRenderer* renderer = renderers[i];
+                rendering = renderer;
+                lock.unlock();
+                waiting |= !renderer->renderPending();
+                lock.lock();
+                rendering = nullptr;
+                rendered.notify_all();
+            }
+
+            // Poll only while a finished table waits for pickup; otherwise sleep
+            // until a request. wake() does not take the mutex, so its
+            // notification can arrive between the check and the wait; the long
+            // timeout only covers that.
+            const auto timeout = waiting ? std::chrono::milliseconds(5) : std::chrono::milliseconds(1000);
+            wakeUp.wait_for(lock, timeout, [this] {
+                return stopping || workRequested.load(std::memory_order_acquire);
+            });
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable rendered;
+    std::vector<LoopTableRenderer*> renderers;
+    LoopTableRenderer* rendering = nullptr;
+    std::atomic<bool> workRequested{false};
+    std::thread thread;
+    bool stopping = false;
+};
+
+LoopTableRenderer::LoopTableRenderer(const float channelSpread) : channelSpread(channelSpread)
+{
+    LoopTableWorker::instance().add(this);
+}
+
+LoopTableRenderer::~LoopTableRenderer()
+{
+    LoopTableWorker::instance().remove(this);
+
+    delete pending.load();
+    delete retired.load();
+    delete playing;
+    delete spare;
+}
+
+void LoopTableRenderer::request(const LoopTable::Key& key)
+{
+    if (key == lastRequest)
+        return;
+    lastRequest = key;
+
+    const uint32_t generation = requestGeneration.load(std::memory_order_relaxed);
+    requestGeneration.store(generation + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    requestedSeed.store(key.seed, std::memory_order_relaxed);
+    requestedSeeded.store(key.seeded, std::memory_order_relaxed);
+    requestedVariant.store(key.variant, std::memory_order_relaxed);
+    requestedLength.store(key.length, std::memory_order_relaxed);
+    requestedChannels.store(key.channels, std::memory_order_relaxed);
+    requestGeneration.store(generation + 2, std::memory_order_release);
+
+    LoopTableWorker::instance().wake();
+}
+
+const LoopTable* LoopTableRenderer::table()
+{
+    LoopTable* finished = pending.load(std::memory_order_acquire);
+    if (finished) {
+        retired.store(playing, std::memory_order_relaxed);
+        playing = finished;
+        pending.store(nullptr, std::memory_order_release);
+    }
+
+    return playing;
+}
+
+bool LoopTableRenderer::renderPending()
+{
+    if (pending.load(std::memory_order_acquire))
+        return false;
+
+    // The audio thread is done with whatever it retired once pending is clear.
+    if (LoopTable* table = retired.exchange(nullptr, std::memory_order_acquire)) {
+        if (spare)
+            delete table;
+        else
+            spare = table;
+    }
+
+    LoopTable::Key key;
+    uint32_t generation;
+    for (;;) {
+        // An odd generation means the audio thread is halfway through a request.
+        generation = requestGeneration.load(std::memory_order_acquire);
+        if (generation & 1)
+            continue;
+
+        key.seed = requestedSeed.load(std::memory_order_relaxed);
+        key.seeded = requestedSeeded.load(std::memory_order_relaxed);
+        key.variant = requestedVariant.load(std::memory_order_relaxed);
+        key.length = requestedLength.load(std::memory_order_relaxed);
+        key.channels = requestedChannels.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (generation == requestGeneration.load(std::memory_order_relaxed))
+            break;
+    }
+
+    if (generation == renderedGeneration || key.length <= 0 || key.channels <= 0)
+        return true;
+
+    LoopTable* table = spare ? spare : new LoopTable();
+    spare = nullptr;
+    table->render(key, channelSpread);
+
+    renderedGeneration = generation;
+    pending.store(table, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// One Tale's noise walk over a loop of `length` noise units, rendered into a
+// table that tiles seamlessly. Channel c walks the noise plane at the same x as
+// the live Tale does.
+struct LoopTable {
+    static constexpr int POINTS_PER_UNIT = 64;
+
+    struct Key {
+        int64_t seed = 0;
+        // False for a module that has not been given a seed yet.
+        bool seeded = false;
+        float variant = 0.f;
+        int length = 0;
+        int channels = 0;
+
+        bool operator==(const Key& other) const
+        {
+            return seed == other.seed && seeded == other.seeded && variant == other.variant && length == other.length && channels == other.channels;
+        }
+
+        bool operator!=(const Key& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    Key key;
+    // Points per channel; channel c starts at points[c * size].
+    int size = 0;
+    std::vector<float> points;
+
+    // Linearly interpolated value at phase, 0 <= phase < key.length.
+    float read(const int channel, const double phase) const
+    {
+        const double position = phase * POINTS_PER_UNIT;
+        const int i = static_cast<int>(position);
+        const float fraction = static_cast<float>(position - i);
+
+        const float* channelPoints = &points[channel * size];
+        const float a = channelPoints[i];
+        const float b = channelPoints[i + 1 < size ? i + 1 : 0];
+        return a + (b - a) * fraction;
+    }
+
+    void render(const Key& newKey, float channelSpread);
+};
+
+// Renders LoopTables on a shared background thread and hands them to the audio
+// thread. request() and table() never lock or allocate; the tables are
+// allocated and freed on the worker.
+class LoopTableRenderer {
+public:
+    explicit LoopTableRenderer(float channelSpread);
+    ~LoopTableRenderer();
+
+    LoopTableRenderer(const LoopTableRenderer&) = delete;
+    LoopTableRenderer& operator=(const LoopTableRenderer&) = delete;
+
+    // Audio thread. Asks for a table for key; cheap when the key is unchanged.
+    void request(const LoopTable::Key& key);
+
+    // Audio thread. The newest finished table, or nullptr before the first one.
+    // The pointer stays valid until the next call.
+    const LoopTable* table();
+
+private:
+    friend class LoopTableWorker;
+
+    // Worker thread. Returns false if a finished table still waits for the audio
+    // thread, so the request has to be looked at again later.
+    bool renderPending();
+
+    const float channelSpread;
+
+    // Written by the audio thread. requestGeneration is odd while the fields
+    // are being written and even once the request is complete.
+    std::atomic<int64_t> requestedSeed{0};
+    std::atomic<bool> requestedSeeded{false};
+    std::atomic<float> requestedVariant{0.f};
+    std::atomic<int> requestedLength{0};
+    std::atomic<int> requestedChannels{0};
+    std::atomic<uint32_t> requestGeneration{0};
+    LoopTable::Key lastRequest;
+
+    // Worker to audio thread: pending is set by the worker and cleared by the
+    // audio thread once it has moved the table it replaces to retired.
+    std::atomic<LoopTable*> pending{nullptr};
+    std::atomic<LoopTable*> retired{nullptr};
+    LoopTable* playing = nullptr;
+
+    // Owned by the worker.
+    uint32_t renderedGeneration = 0;
+    LoopTable* spare = nullptr;
+};
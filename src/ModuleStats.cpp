@@ -0,0 +1,82 @@
+#include "ModuleStats.h"
+
+#ifdef TYCHE_STATS
+
+namespace {
+
+// Menu label that follows the published window for as long as the menu is open.
+struct StatsLabel : ui::MenuLabel {
+    const ModuleStats* stats = nullptr;
+    std::function<std::string(const ModuleStats::Window&)> format;
+
+    void step() override
+    {
+        ModuleStats::Window window;
+        text = stats->read(window) ? format(window) : "Collecting...";
+        MenuLabel::step();
+    }
+};
+
+void addLabel(ui::Menu* menu, const ModuleStats& stats, std::function<std::string(const ModuleStats::Window&)> format)
+{
+    auto* label = new StatsLabel;
+    label->stats = &stats;
+    label->format = format;
+    menu->addChild(label);
+}
+
+std::string formatNs(const double ns)
+{
+    if (ns < 1e3)
+        return string::f("%.0f ns", ns);
+    if (ns < 1e6)
+        return string::f("%.1f us", ns / 1e3);
+    return string::f("%.1f ms", ns / 1e6);
+}
+
+double perSecond(const double count, const ModuleStats::Window& window)
+{
+    return window.seconds > 0.0 ? count / window.seconds : 0.0;
+}
+
+} // namespace
+
+void appendStatsMenu(ui::Menu* menu, const ModuleStats& stats)
+{
+    menu->addChild(new MenuSeparator());
+    menu->addChild(createSubmenuItem("Statistics", "", [&stats](ui::Menu* statsMenu) {
+        statsMenu->addChild(createMenuLabel("Last second of audio"));
+
+        addLabel(statsMenu, stats, [](const ModuleStats::Window& w) {
+            const double mean = w.calls ? static_cast<double>(w.totalNs) / w.calls : 0.0;
+            return "process(): mean " + formatNs(mean) + ", max " + formatNs(w.maxNs);
+        });
+
+        for (int i = 0; i < ModuleStats::BUCKETS; i++) {
+            addLabel(statsMenu, stats, [i](const ModuleStats::Window& w) {
+                const double share = w.calls ? 100.0 * w.histogram[i] / w.calls : 0.0;
+                const double bound = static_cast<double>(1u << (i + ModuleStats::FIRST_BUCKET_BITS));
+                if (i == ModuleStats::BUCKETS - 1)
+                    return string::f("  >= %s: %5.1f%%", formatNs(bound / 2).c_str(), share);
+                return string::f("  < %s: %5.1f%%", formatNs(bound).c_str(), share);
+            });
+        }
+
+        addLabel(statsMenu, stats, [](const ModuleStats::Window& w) {
+            return string::f("Noise evaluations: %.0f/s", perSecond(w.noiseEvals, w));
+        });
+        addLabel(statsMenu, stats, [](const ModuleStats::Window& w) {
+            const double latency = w.events ? static_cast<double>(w.totalLatency) / w.events : 0.0;
+            return string::f("Chain events: %.0f/s, %.1f samples late on average, %u at most",
+                perSecond(w.events, w), latency, w.maxLatency);
+        });
+        addLabel(statsMenu, stats, [](const ModuleStats::Window& w) {
+            return string::f("Dropped events: %u, %llu in total", w.dropped, static_cast<unsigned long long>(w.allDropped));
+        });
+        addLabel(statsMenu, stats, [](const ModuleStats::Window& w) {
+            return string::f("Reseeds: %u, %llu in total", w.reseeds, static_cast<unsigned long long>(w.allReseeds));
+        });
+    }));
+}
+
+#endif
@@ -0,0 +1,150 @@
+#pragma once
+
+// Per-module counters for finding out what a chain spends its time on. Only
+// built with `make STATS=1`, which defines TYCHE_STATS; otherwise the macros
+// below expand to nothing and modules carry no trace of them.
+
+#ifdef TYCHE_STATS
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "plugin.hpp"
+
+// Collected by the engine thread over windows of one second of audio. The last
+// complete window is published for the context menu.
+struct ModuleStats {
+    // process() time histogram: bucket i counts calls under 2^(i + 6) ns, the
+    // last bucket everything slower.
+    static constexpr int BUCKETS = 12;
+    static constexpr int FIRST_BUCKET_BITS = 6;
+
+    struct Window {
+        double seconds = 0.0;
+        uint32_t calls = 0;
+        uint32_t histogram[BUCKETS] = {};
+        uint64_t totalNs = 0;
+        uint32_t maxNs = 0;
+
+        uint32_t noiseEvals = 0;
+        uint32_t reseeds = 0;
+        // Chain events handled by a member, or published by the head.
+        uint32_t events = 0;
+        uint32_t dropped = 0;
+        // Frames between the head detecting an event and a member handling it.
+        uint64_t totalLatency = 0;
+        uint32_t maxLatency = 0;
+
+        // Since the module was created.
+        uint64_t allReseeds = 0;
+        uint64_t allDropped = 0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    // Times one process() call.
+    struct ProcessTimer {
+        ProcessTimer(ModuleStats& stats, const float sampleTime) : stats(stats), sampleTime(sampleTime), start(Clock::now()) {}
+
+        ~ProcessTimer()
+        {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            stats.endProcess(static_cast<uint32_t>(ns), sampleTime);
+        }
+
+        ModuleStats& stats;
+        const float sampleTime;
+        const Clock::time_point start;
+    };
+
+    void countNoise(const uint32_t points)
+    {
+        current.noiseEvals += points;
+    }
+
+    void countReseed()
+    {
+        current.reseeds++;
+        current.allReseeds++;
+    }
+
+    void countEvents(const uint32_t events)
+    {
+        current.events += events;
+    }
+
+    void countEvent(const int64_t latency)
+    {
+        current.events++;
+        current.totalLatency += static_cast<uint64_t>(latency);
+        current.maxLatency = std::max(current.maxLatency, static_cast<uint32_t>(latency));
+    }
+
+    void countDropped(const uint64_t events)
+    {
+        current.dropped += static_cast<uint32_t>(events);
+        current.allDropped += events;
+    }
+
+    // Last complete window; false before the first one is done.
+    bool read(Window& window) const
+    {
+        const int i = latest.load(std::memory_order_acquire);
+        if (i < 0)
+            return false;
+        window = published[i];
+        return true;
+    }
+
+private:
+    void endProcess(const uint32_t ns, const float sampleTime)
+    {
+        int bucket = 0;
+        while (bucket < BUCKETS - 1 && ns >> (bucket + FIRST_BUCKET_BITS))
+            bucket++;
+
+        current.histogram[bucket]++;
+        current.calls++;
+        current.totalNs += ns;
+        current.maxNs = std::max(current.maxNs, ns);
+
+        current.seconds += sampleTime;
+        if (current.seconds >= 1.0)
+            publish();
+    }
+
+    // The menu reads the other buffer, which is only written again a second
+    // later; a torn read would only garble one display.
+    void publish()
+    {
+        const int next = latest.load(std::memory_order_relaxed) == 0 ? 1 : 0;
+        published[next] = current;
+        latest.store(next, std::memory_order_release);
+
+        Window window;
+        window.allReseeds = current.allReseeds;
+        window.allDropped = current.allDropped;
+        current = window;
+    }
+
+    Window current;
+    Window published[2];
+    std::atomic<int> latest{-1};
+};
+
+// Adds a Statistics submenu showing the last window of stats.
+void appendStatsMenu(ui::Menu* menu, const ModuleStats& stats);
+
+// Times the rest of the enclosing process().
+#define TYCHE_STATS_PROCESS(args) const ModuleStats::ProcessTimer statsTimer(stats, (args).sampleTime)
+// Calls one of the count functions, e.g. TYCHE_STATS_COUNT(countNoise(4)).
+#define TYCHE_STATS_COUNT(call) stats.call
+
+#else
+
+#define TYCHE_STATS_PROCESS(args)
+#define TYCHE_STATS_COUNT(call)
+
+#endif
@@ -1,82 +1,189 @@
+#include <algorithm>
+#include <atomic>
+
+#include "CounterRng.h"
 #include "DaisyExpander.h"
 #include "plugin.hpp"
 
 
-struct CrossFadeFilter {
-	float fadeTime = 0.f, fadeProgress = 0.f;
-	bool isFading = false;
+// Easing curves for Moira's fades, sampled once into tables so a fade costs a
+// lookup and a lerp per channel whatever the curve.
+struct FadeCurves {
+	enum Curve { S_CURVE, LINEAR, EXPONENTIAL, CURVES_LEN };
+	static constexpr int POINTS = 1024;
 
-	void start(const float duration) {
-		if (duration <= 0.f) {
-			isFading = false;
-		} else {
-			fadeTime = duration;
-			fadeProgress = 0.f;
-			isFading = true;
+	// One extra point so the lerp at t = 1 stays in bounds.
+	float tables[CURVES_LEN][POINTS + 2];
+
+	FadeCurves() {
+		for (int i = 0; i <= POINTS + 1; i++) {
+			const float t = std::min(static_cast<float>(i) / POINTS, 1.f);
+			tables[S_CURVE][i] = t < 0.5f ? 4 * t * t * t : (t - 1) * (2 * t - 2) * (2 * t - 2) + 1;
+			tables[LINEAR][i] = t;
+			tables[EXPONENTIAL][i] = (1.f - std::exp(-5.f * t)) / (1.f - std::exp(-5.f));
 		}
 	}
 
-	float process(const float prevVoltage, const float currVoltage, const float deltaTime) {
-		if (!isFading)
-			return currVoltage;
+	static const FadeCurves& get() {
+		static const FadeCurves curves;
+		return curves;
+	}
 
-		fadeProgress += deltaTime;
-		const float t = clamp(fadeProgress / fadeTime, 0.f, 1.f);
+	// Curve value for t in [0, 1], linearly interpolated between points.
+	float_4 eval(const int curve, const float_4 t) const {
+		const float_4 x = t * static_cast<float>(POINTS);
+		const simd::int32_4 index = simd::int32_4(x);
+		const float_4 frac = x - float_4(index);
 
-		const float value = crossfade(prevVoltage, currVoltage, easeInOut(t));
+		const float* table = tables[curve];
+		const float_4 a(table[index[0]], table[index[1]], table[index[2]], table[index[3]]);
+		const float_4 b(table[index[0] + 1], table[index[1] + 1], table[index[2] + 1], table[index[3] + 1]);
+		return a + (b - a) * frac;
+	}
+};
 
-		if (t >= 1.f)
-			isFading = false;
 
-		return value;
+// Channels are handled four at a time, as float_4 lanes. Sets of channels
+// are bitmasks, bit c for channel c.
+static constexpr int CHANNEL_GROUPS = PORT_MAX_CHANNELS / 4;
+
+// Bitmask of channels [0, channels).
+inline uint32_t channelMask(const int channels) {
+	return (1u << channels) - 1;
+}
+
+// All bits set in the lanes whose bit is set in the low four bits of `bits`.
+inline float_4 laneMask(const uint32_t bits) {
+	const simd::int32_4 laneBits(1, 2, 4, 8);
+	return float_4::cast((simd::int32_4(static_cast<int32_t>(bits)) & laneBits) == laneBits);
+}
+
+
+// Crossfades for all channels of an output.
+struct CrossFadeBank {
+	static constexpr int GROUPS = CHANNEL_GROUPS;
+
+	float_4 fadeTime[GROUPS] = {};
+	float_4 fadeProgress[GROUPS] = {};
+	// All bits set in the lanes still fading.
+	float_4 fading[GROUPS] = {};
+	// Bit g is set while any lane of group g is fading.
+	uint32_t fadingGroups = 0;
+
+	// Starts a fade on the given channels. A duration of 0 cuts over at once.
+	void start(const uint32_t channels, const float duration) {
+		for (int g = 0; g < GROUPS; g++) {
+			if (!((channels >> (g * 4)) & 0xf))
+				continue;
+
+			const float_4 lanes = laneMask(channels >> (g * 4));
+			if (duration <= 0.f) {
+				fading[g] = fading[g] & ~lanes;
+			} else {
+				fadeTime[g] = simd::ifelse(lanes, float_4(duration), fadeTime[g]);
+				fadeProgress[g] = simd::ifelse(lanes, float_4::zero(), fadeProgress[g]);
+				fading[g] |= lanes;
+			}
+			updateGroup(g);
+		}
 	}
 
-	static float easeInOut(const float t) {
-		if (t < 0.5)
-			return 4 * t * t * t;
+	// Whether any of channels [0, channels) is fading.
+	bool isFading(const int channels) const {
+		if (!fadingGroups)
+			return false;
 
-		return (t - 1) * (2 * t - 2) * (2 * t - 2) + 1;
+		for (int g = 0; g * 4 < channels; g++) {
+			if (simd::movemask(fading[g] & laneMask(channelMask(channels) >> (g * 4))))
+				return true;
+		}
+		return false;
 	}
 
-	json_t* dataToJson() const {
-		json_t* rootJ = json_object();
+	bool isFadingGroup(const int group) const {
+		return fadingGroups & (1u << group);
+	}
 
-		json_t* fadeTimeJ = json_real(fadeTime);
-		json_object_set_new(rootJ, "fadeTime", fadeTimeJ);
+	float_4 process(const int group, const float_4 prevVoltage, const float_4 currVoltage, const float deltaTime, const int curve) {
+		const float_4 lanes = fading[group];
+		fadeProgress[group] += float_4(deltaTime) & lanes;
 
-		json_t* fadeProgressJ = json_real(fadeProgress);
-		json_object_set_new(rootJ, "fadeProgress", fadeProgressJ);
+		// Lanes that are not fading hold a stale or zero fade time; keep them at the end.
+		const float_4 t = simd::ifelse(lanes, simd::clamp(fadeProgress[group] / fadeTime[group], 0.f, 1.f), float_4(1.f));
+		const float_4 value = simd::crossfade(prevVoltage, currVoltage, FadeCurves::get().eval(curve, t));
 
-		json_t* isFadingJ = json_boolean(isFading);
-		json_object_set_new(rootJ, "isFading", isFadingJ);
+		fading[group] = lanes & (t < 1.f);
+		updateGroup(group);
 
-		return rootJ;
+		return simd::ifelse(lanes, value, currVoltage);
 	}
 
-	void dataFromJson(const json_t* rootJ) {
-		const json_t* fadeTimeJ = json_object_get(rootJ, "fadeTime");
-		if (fadeTimeJ)
-			fadeTime = static_cast<float>(json_real_value(fadeTimeJ));
+private:
+	void updateGroup(const int group) {
+		if (simd::movemask(fading[group]))
+			fadingGroups |= 1u << group;
+		else
+			fadingGroups &= ~(1u << group);
+	}
+};
+
+
+// Chosen triggers for a row of outputs on up to 16 channels. Each lane holds
+// the time left on its pulse, as dsp::PulseGenerator does.
+template <int OUTPUTS>
+struct ChosenPulses {
+	float_4 remaining[OUTPUTS][CHANNEL_GROUPS] = {};
+	// The outputs are written until the sample after the last pulse has fallen.
+	bool active = false;
+
+	void trigger(const int output, const uint32_t channels, const float duration = 1e-3f) {
+		for (int g = 0; g < CHANNEL_GROUPS; g++) {
+			if ((channels >> (g * 4)) & 0xf)
+				remaining[output][g] = simd::ifelse(laneMask(channels >> (g * 4)), simd::fmax(remaining[output][g], duration), remaining[output][g]);
+		}
+		active = true;
+	}
+
+	void reset(const uint32_t channels) {
+		for (int o = 0; o < OUTPUTS; o++) {
+			for (int g = 0; g < CHANNEL_GROUPS; g++)
+				remaining[o][g] = simd::ifelse(laneMask(channels >> (g * 4)), float_4::zero(), remaining[o][g]);
+		}
+		active = true;
+	}
+
+	// Writes channels [0, channels) of outputs firstOutput to firstOutput + OUTPUTS - 1.
+	void process(Module* module, const int firstOutput, const int channels, const float deltaTime) {
+		if (!active)
+			return;
 
-		const json_t* fadeProgressJ = json_object_get(rootJ, "fadeProgress");
-		if (fadeProgressJ)
-			fadeProgress = static_cast<float>(json_real_value(fadeProgressJ));
+		int high = 0;
+		for (int o = 0; o < OUTPUTS; o++) {
+			for (int g = 0; g * 4 < channels; g++) {
+				const float_4 pulse = remaining[o][g] > 0.f;
+				remaining[o][g] -= float_4(deltaTime) & pulse;
+				module->getOutput(firstOutput + o).setVoltageSimd(simd::ifelse(pulse, 10.f, 0.f), g * 4);
+				high |= simd::movemask(pulse);
+			}
+		}
 
-		const json_t* isFadingJ = json_object_get(rootJ, "isFading");
-		if (isFadingJ)
-			isFading = json_boolean_value(isFadingJ);
+		active = high;
 	}
 };
 
 
 struct OutputChangeTracker {
-	enum Output { X, Y, Z, NONE };
-	Output currentOutput = NONE;
-	Output previousOutput = NONE;
+	// Outcomes are X, Y and Z, then the slots of any Clothos to the right.
+	enum Output { X, Y, Z, NONE = -1 };
+	// Patches saved before Clotho store NONE as 3.
+	static constexpr int LEGACY_NONE = 3;
+
+	int currentOutput = NONE;
+	int previousOutput = NONE;
 
 	bool hasOutputChanged = false;
 
-	bool process(const Output newState) {
+	bool process(const int newState) {
 		hasOutputChanged = false;
 
 		if (newState != currentOutput) {
@@ -88,11 +195,11 @@ struct OutputChangeTracker {
 		return hasOutputChanged;
 	}
 
-	Output getPreviousOutput() const {
+	int getPreviousOutput() const {
 		return previousOutput;
 	}
 
-	Output getCurrentOutput() const {
+	int getCurrentOutput() const {
 		return currentOutput;
 	}
 
@@ -103,27 +210,291 @@ struct OutputChangeTracker {
 	json_t* dataToJson() const {
 		json_t* rootJ = json_object();
 
-		json_t* currentOutputJ = json_integer(currentOutput);
+		// The output keys keep the old encoding, with Clotho slots saved as none.
+		json_t* currentOutputJ = json_integer(toLegacy(currentOutput));
 		json_object_set_new(rootJ, "currentOutput", currentOutputJ);
 
-		json_t* previousOutputJ = json_integer(previousOutput);
+		json_t* previousOutputJ = json_integer(toLegacy(previousOutput));
 		json_object_set_new(rootJ, "previousOutput", previousOutputJ);
 
+		json_t* currentOutcomeJ = json_integer(currentOutput);
+		json_object_set_new(rootJ, "currentOutcome", currentOutcomeJ);
+
+		json_t* previousOutcomeJ = json_integer(previousOutput);
+		json_object_set_new(rootJ, "previousOutcome", previousOutcomeJ);
+
 		return rootJ;
 	}
 
 	void dataFromJson(const json_t* rootJ) {
 		const json_t* currentOutputJ = json_object_get(rootJ, "currentOutput");
 		if (currentOutputJ)
-			currentOutput = static_cast<Output>(json_integer_value(currentOutputJ));
+			currentOutput = fromLegacy(static_cast<int>(json_integer_value(currentOutputJ)));
 
 		const json_t* previousOutputJ = json_object_get(rootJ, "previousOutput");
 		if (previousOutputJ)
-			previousOutput = static_cast<Output>(json_integer_value(previousOutputJ));
+			previousOutput = fromLegacy(static_cast<int>(json_integer_value(previousOutputJ)));
+
+		const json_t* currentOutcomeJ = json_object_get(rootJ, "currentOutcome");
+		if (currentOutcomeJ)
+			currentOutput = static_cast<int>(json_integer_value(currentOutcomeJ));
+
+		const json_t* previousOutcomeJ = json_object_get(rootJ, "previousOutcome");
+		if (previousOutcomeJ)
+			previousOutput = static_cast<int>(json_integer_value(previousOutcomeJ));
 
 		if (currentOutput != previousOutput)
 			hasOutputChanged = true;
 	}
+
+	static int toLegacy(const int output) {
+		return output >= X && output <= Z ? output : LEGACY_NONE;
+	}
+
+	static int fromLegacy(const int output) {
+		return output >= X && output <= Z ? output : NONE;
+	}
+};
+
+
+// Selections of Moira's poly trigger mode, one array per field so all
+// channels are decided in one batch. Outcomes are numbered as in
+// OutputChangeTracker.
+struct ChannelSelections {
+	int8_t main[PORT_MAX_CHANNELS];
+	int8_t previousMain[PORT_MAX_CHANNELS];
+	int8_t aux[PORT_MAX_CHANNELS];
+	int8_t previousAux[PORT_MAX_CHANNELS];
+
+	// Channels whose selection changed on this sample.
+	uint32_t mainChanged = 0;
+	uint32_t auxChanged = 0;
+
+	ChannelSelections() {
+		std::fill(main, main + PORT_MAX_CHANNELS, OutputChangeTracker::NONE);
+		std::fill(previousMain, previousMain + PORT_MAX_CHANNELS, OutputChangeTracker::NONE);
+		std::fill(aux, aux + PORT_MAX_CHANNELS, OutputChangeTracker::NONE);
+		std::fill(previousAux, previousAux + PORT_MAX_CHANNELS, OutputChangeTracker::NONE);
+	}
+
+	// Gives every channel the selections of the mono trackers.
+	void fill(const OutputChangeTracker& mainTracker, const OutputChangeTracker& auxTracker) {
+		std::fill(main, main + PORT_MAX_CHANNELS, mainTracker.getCurrentOutput());
+		std::fill(previousMain, previousMain + PORT_MAX_CHANNELS, mainTracker.getPreviousOutput());
+		std::fill(aux, aux + PORT_MAX_CHANNELS, auxTracker.getCurrentOutput());
+		std::fill(previousAux, previousAux + PORT_MAX_CHANNELS, auxTracker.getPreviousOutput());
+	}
+
+	void select(const int channel, const int newMain, const int newAux) {
+		if (newMain != main[channel]) {
+			previousMain[channel] = main[channel];
+			main[channel] = static_cast<int8_t>(newMain);
+			mainChanged |= 1u << channel;
+		}
+		if (newAux != aux[channel]) {
+			previousAux[channel] = aux[channel];
+			aux[channel] = static_cast<int8_t>(newAux);
+			auxChanged |= 1u << channel;
+		}
+	}
+
+	json_t* dataToJson() const {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "main", arrayToJson(main));
+		json_object_set_new(rootJ, "previousMain", arrayToJson(previousMain));
+		json_object_set_new(rootJ, "aux", arrayToJson(aux));
+		json_object_set_new(rootJ, "previousAux", arrayToJson(previousAux));
+		return rootJ;
+	}
+
+	void dataFromJson(const json_t* rootJ, const int maxOutcome) {
+		arrayFromJson(json_object_get(rootJ, "main"), main, maxOutcome);
+		arrayFromJson(json_object_get(rootJ, "previousMain"), previousMain, maxOutcome);
+		arrayFromJson(json_object_get(rootJ, "aux"), aux, maxOutcome);
+		arrayFromJson(json_object_get(rootJ, "previousAux"), previousAux, maxOutcome);
+	}
+
+private:
+	static json_t* arrayToJson(const int8_t* outcomes) {
+		json_t* arrayJ = json_array();
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+			json_array_append_new(arrayJ, json_integer(outcomes[c]));
+		return arrayJ;
+	}
+
+	static void arrayFromJson(const json_t* arrayJ, int8_t* outcomes, const int maxOutcome) {
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+			const json_t* outcomeJ = json_array_get(arrayJ, c);
+			if (outcomeJ)
+				outcomes[c] = static_cast<int8_t>(clamp(static_cast<int>(json_integer_value(outcomeJ)), OutputChangeTracker::NONE, maxOutcome));
+		}
+	}
+};
+
+
+// Selection tables over Moira's outcomes. Built from the relative
+// probabilities when they change, so a trigger only searches them.
+template <int N>
+struct OutcomeTable {
+	int count = 0;
+	// Normalized probabilities.
+	float p[N] = {};
+	// cumulative[i] is p[0] + ... + p[i]; the main outcome is the first i with
+	// u < cumulative[i].
+	float cumulative[N] = {};
+	// Outcome to use when u is past the last cumulative value by rounding: the
+	// last one with a probability. NONE if every probability is 0.
+	int fallback = OutputChangeTracker::NONE;
+
+	// For every main outcome m, the same over the other outcomes in order,
+	// renormalized, for the AUX output. auxFallback[m] is m itself if no other
+	// outcome has a probability.
+	float auxCumulative[N][N - 1] = {};
+	int8_t auxOutcomes[N][N - 1] = {};
+	int auxFallback[N] = {};
+
+	// Relative probabilities the table was built from, to detect changes.
+	float weights[N] = {};
+
+	// Rebuilds the tables if the weights differ from the last ones.
+	void update(const float* newWeights, const int newCount) {
+		if (newCount == count && std::equal(newWeights, newWeights + newCount, weights))
+			return;
+
+		count = newCount;
+		std::copy(newWeights, newWeights + newCount, weights);
+
+		float total = 0.f;
+		for (int i = 0; i < count; i++)
+			total += weights[i];
+
+		fallback = OutputChangeTracker::NONE;
+		float sum = 0.f;
+		for (int i = 0; i < count; i++) {
+			p[i] = total > 0.f ? weights[i] / total : 0.f;
+			sum += p[i];
+			cumulative[i] = sum;
+			if (p[i] > 0.f)
+				fallback = i;
+		}
+
+		for (int m = 0; m < count; m++) {
+			float remaining = 0.f;
+			for (int i = 0; i < count; i++) {
+				if (i != m)
+					remaining += p[i];
+			}
+
+			auxFallback[m] = m;
+			float auxSum = 0.f;
+			int k = 0;
+			for (int i = 0; i < count; i++) {
+				if (i == m)
+					continue;
+
+				auxSum += p[i];
+				auxCumulative[m][k] = remaining > 0.f ? auxSum / remaining : 0.f;
+				auxOutcomes[m][k] = static_cast<int8_t>(i);
+				k++;
+				if (remaining > 0.f && p[i] > 0.f)
+					auxFallback[m] = i;
+			}
+		}
+	}
+
+	int selectMain(const float u) const {
+		const int i = std::upper_bound(cumulative, cumulative + count, u) - cumulative;
+		return i < count ? i : fallback;
+	}
+
+	int selectAux(const int main, const float u) const {
+		const int size = count - 1;
+		const float* thresholds = auxCumulative[main];
+		const int k = std::upper_bound(thresholds, thresholds + size, u) - thresholds;
+		return k < size ? auxOutcomes[main][k] : auxFallback[main];
+	}
+};
+
+
+// Companion expander for Moira: three more outcomes, U, V and W, for the
+// nearest Moira on its left. Moira reads the knobs and inputs and drives the
+// lights; the chosen triggers are requested through chosenRequests and
+// chosenChannels.
+struct Clotho final : DaisyExpander {
+	static constexpr int SLOTS = 3;
+
+	enum ParamId {
+		ENUMS(PROB_PARAM, SLOTS),
+		ENUMS(VALUE_PARAM, SLOTS),
+		PARAMS_LEN
+	};
+	enum InputId {
+		ENUMS(PROB_INPUT, SLOTS),
+		ENUMS(VALUE_INPUT, SLOTS),
+		INPUTS_LEN
+	};
+	enum OutputId {
+		ENUMS(CHOSEN_OUTPUT, SLOTS),
+		OUTPUTS_LEN
+	};
+	enum LightId {
+		ENUMS(PROB_LIGHT, SLOTS * 3),
+		LIGHTS_LEN
+	};
+
+	// Bit s * 16 + c asks for a trigger on channel c of slot s; set by Moira,
+	// taken here.
+	std::atomic<uint64_t> chosenRequests{0};
+	// Channels of the chosen outputs, as set by Moira.
+	std::atomic<int> chosenChannels{1};
+
+	ChosenPulses<SLOTS> chosenPulses;
+	int channels = 1;
+
+	Clotho() {
+		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		const std::string names[SLOTS] = {"U", "V", "W"};
+		for (int s = 0; s < SLOTS; s++)
+		{
+			configParam(PROB_PARAM + s, 0.f, 100.f, 0.f, names[s] + " Relative probability", "%");
+			configParam(VALUE_PARAM + s, -10.f, 10.f, 0.f, names[s]);
+			configInput(PROB_INPUT + s, names[s] + " Probability");
+			configInput(VALUE_INPUT + s, names[s]);
+			configOutput(CHOSEN_OUTPUT + s, names[s] + " chosen trigger");
+		}
+	}
+
+	void process(const ProcessArgs& args) override {
+		TYCHE_STATS_PROCESS(args);
+		DaisyExpander::process(args);
+
+		const int newChannels = chosenChannels.load(std::memory_order_relaxed);
+		if (newChannels != channels)
+		{
+			channels = newChannels;
+			chosenPulses.active = true;
+		}
+		for (int s = 0; s < SLOTS; s++)
+			getOutput(CHOSEN_OUTPUT + s).setChannels(channels);
+
+		const uint64_t requests = chosenRequests.exchange(0, std::memory_order_acquire);
+		if (requests)
+		{
+			for (int s = 0; s < SLOTS; s++)
+			{
+				const uint32_t slotChannels = static_cast<uint32_t>(requests >> (s * PORT_MAX_CHANNELS)) & channelMask(PORT_MAX_CHANNELS);
+				if (slotChannels)
+					chosenPulses.trigger(s, slotChannels);
+			}
+		}
+
+		chosenPulses.process(this, CHOSEN_OUTPUT, channels, args.sampleTime);
+	}
+
+	void onUnBypass(const UnBypassEvent& e) override
+	{
+		chosenPulses.active = true;
+	}
 };
 
 
@@ -165,6 +536,13 @@ struct Moira final : DaisyExpander {
 		LIGHTS_LEN
 	};
 
+	static constexpr int OWN_OUTCOMES = 3;
+	static constexpr int MAX_CLOTHOS = 3;
+	static constexpr int MAX_OUTCOMES = OWN_OUTCOMES + MAX_CLOTHOS * Clotho::SLOTS;
+	// Poly trigger channels read the noise plane at x = variant + c * CHANNEL_SPREAD,
+	// as Tale's and Fate's do.
+	static constexpr float CHANNEL_SPREAD = 256.f;
+
 	Moira() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 		configParam(X_PROB_PARAM, 0.f, 100.f, 50.f, "X Relative probability", "%");
@@ -201,8 +579,15 @@ struct Moira final : DaisyExpander {
 	float variant = 1.f;
 	double phase = 0;
 
-	CrossFadeFilter outCrossfadeFilters[PORT_MAX_CHANNELS];
-	CrossFadeFilter auxCrossfadeFilters[PORT_MAX_CHANNELS];
+	// With the counter source every channel numbers its selections since the
+	// last reset; selection n takes the main outcome from counter 2n of the
+	// channel's stream and the aux outcome from counter 2n + 1.
+	int randomSource = CounterRng::SIMPLEX;
+	uint32_t selectionCounts[PORT_MAX_CHANNELS] = {};
+
+	CrossFadeBank outFades;
+	CrossFadeBank auxFades;
+	int fadeCurve = FadeCurves::S_CURVE;
 
 	dsp::ClockDivider variantChangeDivider;
 	dsp::ClockDivider lightDivider;
@@ -215,41 +600,95 @@ struct Moira final : DaisyExpander {
 	OutputChangeTracker mainOutputTracker;
 	OutputChangeTracker auxOutputTracker;
 
-	dsp::PulseGenerator xPulse, yPulse, zPulse;
+	ChosenPulses<OWN_OUTCOMES> chosenPulses;
+
+	// In poly trigger mode every channel of the trigger input makes its own
+	// selection; channel c of the chosen outputs follows channel c's.
+	bool polyTriggers = false;
+	// Channels processed in poly trigger mode, 0 in mono mode.
+	int polyChannels = 0;
+	dsp::TSchmittTrigger<float_4> polyTriggerInputs[CHANNEL_GROUPS];
+	ChannelSelections selections;
+
+	// What updateSettledOutVoltages() last wrote to every channel; 0 channels means unknown.
+	int settledChannels = 0;
+	float settledOutVoltage = 0.f;
+	float settledAuxVoltage = 0.f;
+
+	// Clothos directly to the right, looked up again whenever a module joins or
+	// leaves the chain so a removed one is never touched.
+	Clotho* clothos[MAX_CLOTHOS] = {};
+	int clothoCount = 0;
+	uint32_t clothoTopologyVersion = 0;
+
+	OutcomeTable<MAX_OUTCOMES> outcomes;
+
+	// Where an outcome's knobs, inputs and lights live.
+	struct OutcomeSource {
+		Module* module = nullptr;
+		int probParam = 0;
+		int valueParam = 0;
+		int probInput = 0;
+		int valueInput = 0;
+		int light = 0;
+	};
 
-	struct Probabilities {
-		float x = 0.f;
-		float y = 0.f;
-		float z = 0.f;
+	int outcomeCount() const {
+		return OWN_OUTCOMES + clothoCount * Clotho::SLOTS;
+	}
 
-		Probabilities(float x, float y, float z) {
-			const float totalProb = x + y + z;
-			if (totalProb > 0.f) {
-				this->x = x / totalProb;
-				this->y = y / totalProb;
-				this->z = z / totalProb;
-			}
+	OutcomeSource getOutcomeSource(const int outcome) {
+		OutcomeSource source;
+		if (outcome < 0 || outcome >= outcomeCount())
+			return source;
+
+		if (outcome < OWN_OUTCOMES) {
+			source.module = this;
+			source.probParam = X_PROB_PARAM + outcome;
+			source.valueParam = X_VALUE_PARAM + outcome;
+			source.probInput = X_PROB_INPUT + outcome;
+			source.valueInput = X_VALUE_INPUT + outcome;
+			source.light = X_PROB_LIGHT + outcome * 3;
+			return source;
 		}
 
-		Probabilities() = default;
+		const int slot = (outcome - OWN_OUTCOMES) % Clotho::SLOTS;
+		source.module = clothos[(outcome - OWN_OUTCOMES) / Clotho::SLOTS];
+		source.probParam = Clotho::PROB_PARAM + slot;
+		source.valueParam = Clotho::VALUE_PARAM + slot;
+		source.probInput = Clotho::PROB_INPUT + slot;
+		source.valueInput = Clotho::VALUE_INPUT + slot;
+		source.light = Clotho::PROB_LIGHT + slot * 3;
+		return source;
+	}
 
-		float total() const {
-			return x + y + z;
-		}
-	};
+	void updateClothos() {
+		if (clothoTopologyVersion == getTopologyVersion())
+			return;
+		clothoTopologyVersion = getTopologyVersion();
 
-	Probabilities p;
+		clothoCount = 0;
+		Module* module = getRightExpander().module;
+		while (clothoCount < MAX_CLOTHOS && module && module->model == modelClotho) {
+			clothos[clothoCount++] = static_cast<Clotho*>(module);
+			module = module->getRightExpander().module;
+		}
+	}
 
+	// Reads the relative probabilities; the tables are only rebuilt if one moved.
 	void calculateProbabilities() {
-		const float xProbParam = getProbabilityAt(X_PROB_PARAM, X_PROB_INPUT);
-		const float yProbParam = getProbabilityAt(Y_PROB_PARAM, Y_PROB_INPUT);
-		const float zProbParam = getProbabilityAt(Z_PROB_PARAM, Z_PROB_INPUT);
+		float weights[MAX_OUTCOMES];
+		const int count = outcomeCount();
+		for (int i = 0; i < count; i++)
+			weights[i] = getProbabilityAt(getOutcomeSource(i));
 
-		p = Probabilities(xProbParam, yProbParam, zProbParam);
+		outcomes.update(weights, count);
 	}
 
 	void process(const ProcessArgs& args) override {
+		TYCHE_STATS_PROCESS(args);
 		DaisyExpander::process(args);
+		updateClothos();
 
 		phase += args.sampleTime * PHASE_ADVANCE_SPEED;
 
@@ -260,191 +699,387 @@ struct Moira final : DaisyExpander {
 		if (variant != newVariant && variantChangeDivider.process())
 			variant = newVariant;
 
+		if (polyTriggers) {
+			processPoly(args.sampleTime);
+		} else {
+			if (polyChannels)
+				leavePolyMode();
+			processMono(args.sampleTime);
+		}
+
+		updateLights();
+	}
+
+	void processMono(const float sampleTime) {
 		const bool triggered = triggerInput.process(inputs[TRIGGER_INPUT].getVoltage(), 0.1f, 1.f);
 
-		calculateProbabilities();
+		if (triggered)
+			calculateProbabilities();
 		updatedTrackedOutputs(triggered);
 
-		int numChannels = 1;
-		if (inputs[X_VALUE_INPUT].isConnected())
-			numChannels = std::max(numChannels, inputs[X_VALUE_INPUT].getChannels());
-		if (inputs[Y_VALUE_INPUT].isConnected())
-			numChannels = std::max(numChannels, inputs[Y_VALUE_INPUT].getChannels());
-		if (inputs[Z_VALUE_INPUT].isConnected())
-			numChannels = std::max(numChannels, inputs[Z_VALUE_INPUT].getChannels());
-
+		const int numChannels = getValueChannels();
 		outputs[OUT_OUTPUT].setChannels(numChannels);
 		outputs[AUX_OUTPUT].setChannels(numChannels);
 
-		const float fadeDuration = getParam(FADE_PARAM).getValue();
+		if (mainOutputTracker.hasChanged() || auxOutputTracker.hasChanged()) {
+			const float fadeDuration = getParam(FADE_PARAM).getValue();
+
+			if (mainOutputTracker.hasChanged())
+				outFades.start(channelMask(numChannels), fadeDuration);
+
+			if (auxOutputTracker.hasChanged())
+				auxFades.start(channelMask(numChannels), fadeDuration);
+		}
 
-		if (mainOutputTracker.hasChanged()) {
-			for (int c = 0; c < numChannels; c++) {
-				outCrossfadeFilters[c].start(fadeDuration);
+		if (outFades.isFading(numChannels) || auxFades.isFading(numChannels)) {
+			for (int c = 0; c < numChannels; c += 4) {
+				updateOutVoltagesWithFade(c, sampleTime);
 			}
+			settledChannels = 0;
+		} else {
+			updateSettledOutVoltages(numChannels);
+		}
+
+		updateChosenOutput(triggered, sampleTime);
+	}
+
+	// Every channel of the trigger input decides on its own: triggers are
+	// detected four channels at a time, then the noise for all triggered
+	// channels is evaluated in one batch before the selections are made.
+	void processPoly(const float sampleTime) {
+		const Input& triggerIn = getInput(TRIGGER_INPUT);
+		const int numChannels = std::max(getValueChannels(), triggerIn.getChannels());
+		if (!polyChannels)
+			selections.fill(mainOutputTracker, auxOutputTracker);
+		if (numChannels != polyChannels) {
+			polyChannels = numChannels;
+			chosenPulses.active = true;
+		}
+
+		selections.mainChanged = 0;
+		selections.auxChanged = 0;
+
+		uint32_t triggered = 0;
+		for (int c = 0; c < numChannels; c += 4)
+			triggered |= simd::movemask(polyTriggerInputs[c / 4].process(triggerIn.getPolyVoltageSimd<float_4>(c), 0.1f, 1.f)) << c;
+		triggered &= channelMask(numChannels);
+
+		if (triggered) {
+			calculateProbabilities();
+			selectChannels(triggered);
 		}
 
-		if (auxOutputTracker.hasChanged()) {
-			for (int c = 0; c < numChannels; c++) {
-				auxCrossfadeFilters[c].start(fadeDuration);
+		outputs[OUT_OUTPUT].setChannels(numChannels);
+		outputs[AUX_OUTPUT].setChannels(numChannels);
+
+		if (selections.mainChanged || selections.auxChanged) {
+			const float fadeDuration = getParam(FADE_PARAM).getValue();
+			if (selections.mainChanged)
+				outFades.start(selections.mainChanged, fadeDuration);
+			if (selections.auxChanged)
+				auxFades.start(selections.auxChanged, fadeDuration);
+		}
+
+		for (int c = 0; c < numChannels; c += 4)
+			updatePolyOutVoltages(c, sampleTime);
+		settledChannels = 0;
+
+		const uint32_t chosen = triggered | selections.mainChanged;
+		if (chosen)
+			triggerChosenChannels(chosen);
+		updatedChosenOutputTriggers(numChannels, sampleTime);
+	}
+
+	void selectChannels(const uint32_t triggered) {
+		float mainNoise[PORT_MAX_CHANNELS];
+		float auxNoise[PORT_MAX_CHANNELS];
+		for (int c = 0; c < PORT_MAX_CHANNELS; c += 4) {
+			if (!((triggered >> c) & 0xf))
+				continue;
+
+			if (randomSource == CounterRng::COUNTER) {
+				for (int i = c; i < c + 4; i++) {
+					if (triggered & (1u << i))
+						sampleCounter(i, mainNoise[i], auxNoise[i]);
+				}
+				continue;
 			}
+
+			double xs[4];
+			double mainYs[4];
+			double auxYs[4];
+			for (int i = 0; i < 4; i++) {
+				xs[i] = variant + static_cast<float>(c + i) * CHANNEL_SPREAD;
+				mainYs[i] = phase;
+				auxYs[i] = phase + AUX_OFFSET;
+			}
+
+			// Noise from [-1, 1] to [0, 1], as sampleNoise() does.
+			TYCHE_STATS_COUNT(countNoise(8));
+			((simdNoise->eval(xs, mainYs) + 1.f) * 0.5f).store(&mainNoise[c]);
+			((simdNoise->eval(xs, auxYs) + 1.f) * 0.5f).store(&auxNoise[c]);
 		}
 
-		for (int c = 0; c < numChannels; c++) {
-			updateOutVoltagesWithFade(c, args.sampleTime);
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+			if (!(triggered & (1u << c)))
+				continue;
+
+			// Without any probability the channel stays where it is.
+			const int main = outcomes.selectMain(mainNoise[c]);
+			if (main == OutputChangeTracker::NONE)
+				continue;
+
+			selections.select(c, main, outcomes.selectAux(main, auxNoise[c]));
 		}
+	}
 
-		updateChosenOutput(triggered, args.sampleTime);
-		updateLights();
+	// Chosen triggers for the given channels, each on the outcome it selected.
+	void triggerChosenChannels(const uint32_t channels) {
+		uint32_t outcomeChannels[MAX_OUTCOMES] = {};
+		uint32_t noneChannels = 0;
+		for (int c = 0; c < polyChannels; c++) {
+			const uint32_t bit = 1u << c;
+			if (!(channels & bit))
+				continue;
+
+			const int outcome = selections.main[c];
+			if (outcome >= 0 && outcome < outcomeCount())
+				outcomeChannels[outcome] |= bit;
+			else
+				noneChannels |= bit;
+		}
+
+		for (int o = 0; o < outcomeCount(); o++) {
+			if (outcomeChannels[o])
+				triggerChosen(o, outcomeChannels[o]);
+		}
+		if (noneChannels)
+			chosenPulses.reset(noneChannels);
 	}
 
-	void updateChosenOutput(const bool triggered, const float delta) {
-		const OutputChangeTracker::Output chosenOutput = mainOutputTracker.getCurrentOutput();
-		if (!mainOutputTracker.hasChanged() && !triggered) {
-			updatedChosenOutputTriggers(delta);
+	void triggerChosen(const int outcome, const uint32_t channels) {
+		if (outcome < OWN_OUTCOMES) {
+			chosenPulses.trigger(outcome, channels);
 			return;
 		}
 
-		switch (chosenOutput) {
-		case OutputChangeTracker::X:
-			xPulse.trigger(1e-3);
-			break;
-		case OutputChangeTracker::Y:
-			yPulse.trigger(1e-3);
-			break;
-		case OutputChangeTracker::Z:
-			zPulse.trigger(1e-3);
-			break;
-		default:
-			xPulse.reset(); yPulse.reset(); zPulse.reset();
+		const int slot = (outcome - OWN_OUTCOMES) % Clotho::SLOTS;
+		Clotho* clotho = clothos[(outcome - OWN_OUTCOMES) / Clotho::SLOTS];
+		clotho->chosenRequests.fetch_or(static_cast<uint64_t>(channels) << (slot * PORT_MAX_CHANNELS), std::memory_order_release);
+	}
+
+	// Channels [firstChannel, firstChannel + 4) of both outputs in poly
+	// trigger mode, each following its own selection.
+	void updatePolyOutVoltages(const int firstChannel, const float delta) {
+		const int group = firstChannel / 4;
+
+		const float_4 currOutVoltage = getSelectedVoltages(selections.main, firstChannel);
+		if (outFades.isFadingGroup(group)) {
+			const float_4 prevOutVoltage = getSelectedVoltages(selections.previousMain, firstChannel);
+			outputs[OUT_OUTPUT].setVoltageSimd(outFades.process(group, prevOutVoltage, currOutVoltage, delta, fadeCurve), firstChannel);
+		} else {
+			outputs[OUT_OUTPUT].setVoltageSimd(currOutVoltage, firstChannel);
+		}
+
+		const float_4 currAuxVoltage = getSelectedVoltages(selections.aux, firstChannel);
+		if (auxFades.isFadingGroup(group)) {
+			const float_4 prevAuxVoltage = getSelectedVoltages(selections.previousAux, firstChannel);
+			outputs[AUX_OUTPUT].setVoltageSimd(auxFades.process(group, prevAuxVoltage, currAuxVoltage, delta, fadeCurve), firstChannel);
+		} else {
+			outputs[AUX_OUTPUT].setVoltageSimd(currAuxVoltage, firstChannel);
 		}
+	}
 
-		updatedChosenOutputTriggers(delta);
+	// Voltages of channels [firstChannel, firstChannel + 4), each for the
+	// outcome in its lane of `selection`.
+	float_4 getSelectedVoltages(const int8_t* selection, const int firstChannel) {
+		const int8_t* lanes = selection + firstChannel;
+		if (lanes[0] == lanes[1] && lanes[0] == lanes[2] && lanes[0] == lanes[3])
+			return getActiveOutputVoltages(lanes[0], firstChannel);
+
+		float_4 voltages;
+		for (int i = 0; i < 4; i++)
+			voltages[i] = getActiveOutputVoltages(lanes[i], firstChannel)[i];
+		return voltages;
 	}
 
-	void updatedChosenOutputTriggers(const float delta) {
-		getOutput(X_CHOSEN_OUTPUT).setVoltage(xPulse.process(delta) ? 10.f : 0.f);
-		getOutput(Y_CHOSEN_OUTPUT).setVoltage(yPulse.process(delta) ? 10.f : 0.f);
-		getOutput(Z_CHOSEN_OUTPUT).setVoltage(zPulse.process(delta) ? 10.f : 0.f);
+	// Hands channel 0's selections back to the mono trackers, so the outputs
+	// keep their values.
+	void leavePolyMode() {
+		mainOutputTracker.currentOutput = selections.main[0];
+		mainOutputTracker.previousOutput = selections.previousMain[0];
+		auxOutputTracker.currentOutput = selections.aux[0];
+		auxOutputTracker.previousOutput = selections.previousAux[0];
+
+		polyChannels = 0;
+		chosenPulses.reset(~channelMask(1));
+		settledChannels = 0;
 	}
 
-	void updatedTrackedOutputs(const bool triggered) {
-		if (!triggered) {
-			mainOutputTracker.process(mainOutputTracker.getCurrentOutput());
-			auxOutputTracker.process(auxOutputTracker.getCurrentOutput());
+	// Channels of the value inputs of all outcomes, at least 1.
+	int getValueChannels() {
+		int numChannels = 1;
+		for (int i = 0; i < outcomeCount(); i++) {
+			const OutcomeSource source = getOutcomeSource(i);
+			const Input& valueInput = source.module->getInput(source.valueInput);
+			if (valueInput.isConnected())
+				numChannels = std::max(numChannels, valueInput.getChannels());
+		}
+		return numChannels;
+	}
+
+	// Without a running fade the outputs simply follow the selected values. If
+	// those come from the knobs alone they are the same on every channel and
+	// only need writing when a knob moves or the channel count changes.
+	void updateSettledOutVoltages(const int numChannels) {
+		const int mainOutput = mainOutputTracker.getCurrentOutput();
+		const int auxOutput = auxOutputTracker.getCurrentOutput();
+
+		if (isValueInputConnected(mainOutput) || isValueInputConnected(auxOutput)) {
+			for (int c = 0; c < numChannels; c += 4) {
+				outputs[OUT_OUTPUT].setVoltageSimd(getActiveOutputVoltages(mainOutput, c), c);
+				outputs[AUX_OUTPUT].setVoltageSimd(getActiveOutputVoltages(auxOutput, c), c);
+			}
+			settledChannels = 0;
 			return;
 		}
 
-		const float noiseVal = sampleNoise();
+		const float outVoltage = getActiveOutputVoltages(mainOutput, 0)[0];
+		const float auxVoltage = getActiveOutputVoltages(auxOutput, 0)[0];
+		if (numChannels == settledChannels && outVoltage == settledOutVoltage && auxVoltage == settledAuxVoltage)
+			return;
 
-		if (p.x >= 0.f && noiseVal < p.x) {
-			mainOutputTracker.process(OutputChangeTracker::X);
+		for (int c = 0; c < numChannels; c++) {
+			outputs[OUT_OUTPUT].setVoltage(outVoltage, c);
+			outputs[AUX_OUTPUT].setVoltage(auxVoltage, c);
+		}
 
-			if (p.y + p.z == 0.f) {
-				auxOutputTracker.process(OutputChangeTracker::X);
-				return;
-			}
+		settledChannels = numChannels;
+		settledOutVoltage = outVoltage;
+		settledAuxVoltage = auxVoltage;
+	}
 
-			const float auxYprob = p.y / (p.y + p.z);
-			if (sampleNoise(AUX_OFFSET) < auxYprob) {
-				auxOutputTracker.process(OutputChangeTracker::Y);
-			} else {
-				auxOutputTracker.process(OutputChangeTracker::Z);
-			}
+	bool isValueInputConnected(const int output) {
+		const OutcomeSource source = getOutcomeSource(output);
+		return source.module && source.module->getInput(source.valueInput).isConnected();
+	}
 
-		} else if (p.y >= 0.f && noiseVal <= p.x + p.y) {
-			mainOutputTracker.process(OutputChangeTracker::Y);
+	void updateChosenOutput(const bool triggered, const float delta) {
+		if (mainOutputTracker.hasChanged() || triggered) {
+			const int chosenOutput = mainOutputTracker.getCurrentOutput();
+			if (chosenOutput >= 0 && chosenOutput < outcomeCount())
+				triggerChosen(chosenOutput, channelMask(1));
+			else
+				chosenPulses.reset(channelMask(1));
+		}
 
-			if (p.x + p.z == 0.f) {
-				auxOutputTracker.process(OutputChangeTracker::Y);
-				return;
-			}
+		updatedChosenOutputTriggers(1, delta);
+	}
 
-			const float auxXprob = p.x / (p.x + p.z);
-			if (sampleNoise(AUX_OFFSET) < auxXprob) {
-				auxOutputTracker.process(OutputChangeTracker::X);
-			} else {
-				auxOutputTracker.process(OutputChangeTracker::Z);
-			}
+	void updatedChosenOutputTriggers(const int numChannels, const float delta) {
+		for (int i = 0; i < OWN_OUTCOMES; i++)
+			getOutput(X_CHOSEN_OUTPUT + i).setChannels(numChannels);
+		for (int i = 0; i < clothoCount; i++)
+			clothos[i]->chosenChannels.store(numChannels, std::memory_order_relaxed);
 
-		} else if (p.z > 0.f) {
-			mainOutputTracker.process(OutputChangeTracker::Z);
+		chosenPulses.process(this, X_CHOSEN_OUTPUT, numChannels, delta);
+	}
 
-			if (p.x + p.y == 0.f) {
-				auxOutputTracker.process(OutputChangeTracker::Z);
-				return;
-			}
+	void updatedTrackedOutputs(const bool triggered) {
+		if (!triggered) {
+			mainOutputTracker.process(mainOutputTracker.getCurrentOutput());
+			auxOutputTracker.process(auxOutputTracker.getCurrentOutput());
+			return;
+		}
 
-			const float auxXprob = p.x / (p.x + p.y);
-			if (sampleNoise(AUX_OFFSET) < auxXprob) {
-				auxOutputTracker.process(OutputChangeTracker::X);
-			} else {
-				auxOutputTracker.process(OutputChangeTracker::Y);
-			}
+		float mainNoise;
+		float auxNoise;
+		if (randomSource == CounterRng::COUNTER) {
+			sampleCounter(0, mainNoise, auxNoise);
+		} else {
+			mainNoise = sampleNoise();
+			auxNoise = sampleNoise(AUX_OFFSET);
 		}
+
+		// Without any probability the outputs stay where they are.
+		const int mainOutput = outcomes.selectMain(mainNoise);
+		if (mainOutput == OutputChangeTracker::NONE)
+			return;
+
+		mainOutputTracker.process(mainOutput);
+		auxOutputTracker.process(outcomes.selectAux(mainOutput, auxNoise));
 	}
 
 	float sampleNoise(const float offset = 0.f) const
 	{
+		TYCHE_STATS_COUNT(countNoise(1));
 		return rescale(noise->eval(variant, phase + offset), -1.f, 1.f, 0.f, 1.f);
 	}
 
-	void updateOutVoltagesWithFade(const int channel, const float delta)
+	// Next selection of channel c from the counter generator, in [0, 1).
+	void sampleCounter(const int c, float& mainNoise, float& auxNoise)
 	{
-		const float prevOutVoltage = getActiveOutputVoltage(mainOutputTracker.getPreviousOutput(), channel);
-		const float currOutVoltage = getActiveOutputVoltage(mainOutputTracker.getCurrentOutput(), channel);
-		outputs[OUT_OUTPUT].setVoltage(outCrossfadeFilters[channel].process(prevOutVoltage, currOutVoltage, delta), channel);
-
-		const float prevAuxVoltage = getActiveOutputVoltage(auxOutputTracker.getPreviousOutput(), channel);
-		const float currAuxVoltage = getActiveOutputVoltage(auxOutputTracker.getCurrentOutput(), channel);
-		outputs[AUX_OUTPUT].setVoltage(auxCrossfadeFilters[channel].process(prevAuxVoltage, currAuxVoltage, delta), channel);
+		const uint32_t stream = CounterRng::stream(variant, c);
+		const uint64_t counter = 2 * static_cast<uint64_t>(selectionCounts[c]++);
+		mainNoise = CounterRng::uniform(seed, stream, counter);
+		auxNoise = CounterRng::uniform(seed, stream, counter + 1);
 	}
 
-	float getActiveOutputVoltage(const OutputChangeTracker::Output output, const int channel)
+	// Channels [firstChannel, firstChannel + 4) of both outputs; groups whose
+	// fade has finished just follow the selected values.
+	void updateOutVoltagesWithFade(const int firstChannel, const float delta)
 	{
-		switch (output) {
-		case OutputChangeTracker::X:
-			return getVoltageAt(X_VALUE_PARAM, X_VALUE_INPUT, channel);
-		case OutputChangeTracker::Y:
-			return getVoltageAt(Y_VALUE_PARAM, Y_VALUE_INPUT, channel);
-		case OutputChangeTracker::Z:
-			return getVoltageAt(Z_VALUE_PARAM, Z_VALUE_INPUT, channel);
-		default:
-			return 0.f;
+		const int group = firstChannel / 4;
+
+		const float_4 currOutVoltage = getActiveOutputVoltages(mainOutputTracker.getCurrentOutput(), firstChannel);
+		if (outFades.isFadingGroup(group)) {
+			const float_4 prevOutVoltage = getActiveOutputVoltages(mainOutputTracker.getPreviousOutput(), firstChannel);
+			outputs[OUT_OUTPUT].setVoltageSimd(outFades.process(group, prevOutVoltage, currOutVoltage, delta, fadeCurve), firstChannel);
+		} else {
+			outputs[OUT_OUTPUT].setVoltageSimd(currOutVoltage, firstChannel);
+		}
+
+		const float_4 currAuxVoltage = getActiveOutputVoltages(auxOutputTracker.getCurrentOutput(), firstChannel);
+		if (auxFades.isFadingGroup(group)) {
+			const float_4 prevAuxVoltage = getActiveOutputVoltages(auxOutputTracker.getPreviousOutput(), firstChannel);
+			outputs[AUX_OUTPUT].setVoltageSimd(auxFades.process(group, prevAuxVoltage, currAuxVoltage, delta, fadeCurve), firstChannel);
+		} else {
+			outputs[AUX_OUTPUT].setVoltageSimd(currAuxVoltage, firstChannel);
 		}
 	}
 
+	// 0V for no outcome, or one whose Clotho has been removed.
+	float_4 getActiveOutputVoltages(const int output, const int firstChannel)
+	{
+		const OutcomeSource source = getOutcomeSource(output);
+		if (!source.module)
+			return float_4::zero();
+
+		return getVoltagesAt(source, firstChannel);
+	}
+
 	enum Color { WHITE, GREEN, BLUE };
 
 	void updateLights() {
 		if (!lightDivider.process())
 			return;
 
-		setLight(X_PROB_LIGHT, p.x, WHITE);
-		setLight(Y_PROB_LIGHT, p.y, WHITE);
-		setLight(Z_PROB_LIGHT, p.z, WHITE);
+		calculateProbabilities();
+
+		for (int i = 0; i < outcomes.count; i++)
+			setLight(i, outcomes.p[i], WHITE);
 
-		updateOutputLight(mainOutputTracker.getCurrentOutput(), GREEN);
-		updateOutputLight(auxOutputTracker.getCurrentOutput(), BLUE);
+		// In poly trigger mode the lights show channel 0.
+		updateOutputLight(polyChannels ? selections.main[0] : mainOutputTracker.getCurrentOutput(), GREEN);
+		updateOutputLight(polyChannels ? selections.aux[0] : auxOutputTracker.getCurrentOutput(), BLUE);
 	}
 
-	void updateOutputLight(const OutputChangeTracker::Output output, Color color) {
-		switch (output) {
-			case OutputChangeTracker::X:
-				setLight(X_PROB_LIGHT, p.x, color);
-				break;
-			case OutputChangeTracker::Y:
-				setLight(Y_PROB_LIGHT, p.y, color);
-				break;
-			case OutputChangeTracker::Z:
-				setLight(Z_PROB_LIGHT, p.z, color);
-				break;
-			default:
-				break;
-		}
+	void updateOutputLight(const int output, Color color) {
+		if (output >= 0 && output < outcomes.count)
+			setLight(output, outcomes.p[output], color);
 	}
 
-	void setLight(const LightId lightId, const float brightness, const Color color) {
+	void setLight(const int outcome, const float brightness, const Color color) {
 		float red, green, blue;
 
 		switch (color) {
@@ -466,39 +1101,45 @@ struct Moira final : DaisyExpander {
 				break;
 		}
 
-		getLight(lightId + 0).setBrightness(red);
-		getLight(lightId + 1).setBrightness(green);
-		getLight(lightId + 2).setBrightness(blue);
+		const OutcomeSource source = getOutcomeSource(outcome);
+		source.module->getLight(source.light + 0).setBrightness(red);
+		source.module->getLight(source.light + 1).setBrightness(green);
+		source.module->getLight(source.light + 2).setBrightness(blue);
 	}
 
-	float getProbabilityAt(const ParamId probParam, const InputId probInput)
+	float getProbabilityAt(const OutcomeSource& source)
 	{
-		float value = getParam(probParam).getValue();
+		float value = source.module->getParam(source.probParam).getValue();
 
-		if (getInput(probInput).isConnected())
+		if (source.module->getInput(source.probInput).isConnected())
 		{
-			value *= rescale(getInput(probInput).getVoltage(), -5.f, 5.f, 0.f, 1.f);
+			value *= rescale(source.module->getInput(source.probInput).getVoltage(), -5.f, 5.f, 0.f, 1.f);
 		}
 
 		return value;
 	}
 
-	float getVoltageAt(const ParamId param, const InputId input, const int channel)
+	float_4 getVoltagesAt(const OutcomeSource& source, const int firstChannel)
 	{
-		float value = getParam(param).getValue();
+		const float value = source.module->getParam(source.valueParam).getValue();
+		const Input& input = source.module->getInput(source.valueInput);
+		if (!input.isConnected())
+			return float_4(value);
 
-		if (getInput(input).isConnected())
-		{
-			value = getInput(input).getVoltage(channel);
-			value *= rescale(getParam(param).getValue(), -10.f, 10.f, 0.f, 1.f);
-		}
-
-		return value;
+		return input.getPolyVoltageSimd<float_4>(firstChannel) * rescale(value, -10.f, 10.f, 0.f, 1.f);
 	}
 
 	void reset() override
 	{
 		phase = 0;
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+			selectionCounts[c] = 0;
+	}
+
+	void onUnBypass(const UnBypassEvent& e) override
+	{
+		settledChannels = 0;
+		chosenPulses.active = true;
 	}
 
 	json_t* dataToJson() override {
@@ -519,6 +1160,23 @@ struct Moira final : DaisyExpander {
 		json_t* seedJ = json_integer(seed);
 		json_object_set_new(rootJ, "seed", seedJ);
 
+		json_t* fadeCurveJ = json_integer(fadeCurve);
+		json_object_set_new(rootJ, "fadeCurve", fadeCurveJ);
+
+		json_t* polyTriggersJ = json_boolean(polyTriggers);
+		json_object_set_new(rootJ, "polyTriggers", polyTriggersJ);
+
+		json_t* selectionsJ = selections.dataToJson();
+		json_object_set_new(rootJ, "selections", selectionsJ);
+
+		json_t* randomSourceJ = json_integer(randomSource);
+		json_object_set_new(rootJ, "randomSource", randomSourceJ);
+
+		json_t* selectionCountsJ = json_array();
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+			json_array_append_new(selectionCountsJ, json_integer(selectionCounts[c]));
+		json_object_set_new(rootJ, "selectionCounts", selectionCountsJ);
+
 		return rootJ;
 	}
 
@@ -540,8 +1198,39 @@ struct Moira final : DaisyExpander {
 			auxOutputTracker.dataFromJson(auxOutputTrackerJ);
 
 		const json_t* seedJ = json_object_get(rootJ, "seed");
-		if (seedJ)
+		if (seedJ) {
 			seed = static_cast<int>(json_integer_value(seedJ));
+			reseedNoise(seed);
+		}
+
+		const json_t* fadeCurveJ = json_object_get(rootJ, "fadeCurve");
+		if (fadeCurveJ)
+			fadeCurve = clamp(static_cast<int>(json_integer_value(fadeCurveJ)), 0, FadeCurves::CURVES_LEN - 1);
+
+		const json_t* polyTriggersJ = json_object_get(rootJ, "polyTriggers");
+		if (polyTriggersJ)
+			polyTriggers = json_boolean_value(polyTriggersJ);
+
+		const json_t* randomSourceJ = json_object_get(rootJ, "randomSource");
+		if (randomSourceJ)
+			randomSource = clamp(static_cast<int>(json_integer_value(randomSourceJ)), 0, CounterRng::SOURCES_LEN - 1);
+
+		const json_t* selectionCountsJ = json_object_get(rootJ, "selectionCounts");
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+			const json_t* countJ = json_array_get(selectionCountsJ, c);
+			if (countJ)
+				selectionCounts[c] = static_cast<uint32_t>(json_integer_value(countJ));
+		}
+
+		// The selections the patch was saved with win over those of the mode
+		// being left or entered on the next sample.
+		const json_t* selectionsJ = json_object_get(rootJ, "selections");
+		if (polyTriggers && selectionsJ) {
+			selections.dataFromJson(selectionsJ, MAX_OUTCOMES - 1);
+			polyChannels = std::max(polyChannels, 1);
+		} else {
+			selections.fill(mainOutputTracker, auxOutputTracker);
+		}
 	}
 
 	void processSeed(int newSeed) override {
@@ -587,7 +1276,47 @@ struct MoiraWidget final : ModuleWidget {
 		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(37.62, 96.5)), module, Moira::AUX_OUTPUT));
 		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(37.62, 114.233)), module, Moira::OUT_OUTPUT));
 	}
+
+	void appendContextMenu(ui::Menu* menu) override {
+		Moira* module = getModule<Moira>();
+
+		menu->addChild(new MenuSeparator());
+		menu->addChild(createIndexPtrSubmenuItem("Fade curve", {"S-curve", "Linear", "Exponential"}, &module->fadeCurve));
+		menu->addChild(createIndexPtrSubmenuItem("Randomness", {"Simplex noise", "Counter (uniform)"}, &module->randomSource));
+		menu->addChild(createBoolPtrMenuItem("Poly trigger (one selection per channel)", "", &module->polyTriggers));
+
+#ifdef TYCHE_STATS
+		appendStatsMenu(menu, module->stats);
+#endif
+	}
+};
+
+
+
+
+struct ClothoWidget final : ModuleWidget {
+	explicit ClothoWidget(Clotho* module) {
+		setModule(module);
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/Clotho.svg")));
+
+		for (int s = 0; s < Clotho::SLOTS; s++)
+		{
+			const float x = 6.5f + 8.74f * s;
+			addParam(createLightParamCentered<VCVLightSlider<RedGreenBlueLight>>(mm2px(Vec(x, 24.0)), module, Clotho::PROB_PARAM + s, Clotho::PROB_LIGHT + s * 3));
+			addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(x, 43.5)), module, Clotho::PROB_INPUT + s));
+			addParam(createParamCentered<RoundSmallBlackKnob>(mm2px(Vec(x, 53.75)), module, Clotho::VALUE_PARAM + s));
+			addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(x, 64.021)), module, Clotho::VALUE_INPUT + s));
+			addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(x, 74.791)), module, Clotho::CHOSEN_OUTPUT + s));
+		}
+	}
+
+#ifdef TYCHE_STATS
+	void appendContextMenu(ui::Menu* menu) override {
+		appendStatsMenu(menu, getModule<Clotho>()->stats);
+	}
+#endif
 };
 
 
 Model* modelMoira = createModel<Moira, MoiraWidget>("Moira");
+Model* modelClotho = createModel<Clotho, ClothoWidget>("Clotho");
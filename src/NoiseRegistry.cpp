@@ -0,0 +1,133 @@
+#include "NoiseRegistry.h"
+
+#include <cassert>
+#include <new>
+#include <thread>
+
+void NoiseTables::build(const int64_t newSeed)
+{
+    // Noise holds only fixed-size arrays, so constructing it in place does not allocate.
+    destroy();
+    new (noiseStorage) OpenSimplexNoise::Noise(newSeed);
+    simd.reseed(newSeed);
+    built = true;
+    ready.store(true, std::memory_order_release);
+}
+
+void NoiseTables::destroy()
+{
+    if (built)
+        noise()->~Noise();
+    built = false;
+}
+
+NoiseRegistry& NoiseRegistry::instance()
+{
+    static NoiseRegistry registry;
+    return registry;
+}
+
+NoiseRegistry::~NoiseRegistry()
+{
+    while (chunks) {
+        Chunk* next = chunks->next;
+        for (NoiseTables& entry : chunks->entries)
+            entry.destroy();
+        delete chunks;
+        chunks = next;
+    }
+}
+
+void NoiseRegistry::lock()
+{
+    while (spinLock.test_and_set(std::memory_order_acquire)) {}
+}
+
+void NoiseRegistry::unlock()
+{
+    spinLock.clear(std::memory_order_release);
+}
+
+void NoiseRegistry::addUser()
+{
+    lock();
+    const bool full = ++users > capacity;
+    unlock();
+
+    if (!full)
+        return;
+
+    // Allocate outside the lock; only linking the chunk in has to be exclusive.
+    Chunk* chunk = new Chunk();
+
+    lock();
+    chunk->next = chunks;
+    chunks = chunk;
+    capacity += CHUNK_SIZE;
+    unlock();
+}
+
+void NoiseRegistry::removeUser()
+{
+    lock();
+    users--;
+    unlock();
+}
+
+const NoiseTables* NoiseRegistry::acquire(const int64_t seed)
+{
+    lock();
+
+    NoiseTables* candidate = nullptr;
+    for (Chunk* chunk = chunks; chunk; chunk = chunk->next) {
+        for (NoiseTables& entry : chunk->entries) {
+            if (entry.assigned && entry.seed == seed) {
+                entry.holders++;
+                unlock();
+
+                // The build is short and only happens on a seed change.
+                while (!entry.ready.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                return &entry;
+            }
+
+            // Prefer never-assigned entries so cached tables survive as long as possible.
+            if (entry.holders == 0 && (!candidate || (candidate->assigned && !entry.assigned)))
+                candidate = &entry;
+        }
+    }
+
+    // Claim the entry, then build it without holding up the other threads.
+    // Nobody reads an entry without holders, and newcomers wait for ready.
+    assert(candidate && "more noise tables held than registered users");
+    candidate->seed = seed;
+    candidate->assigned = true;
+    candidate->holders = 1;
+    candidate->ready.store(false, std::memory_order_relaxed);
+    unlock();
+
+    candidate->build(seed);
+    return candidate;
+}
+
+void NoiseRegistry::release(const NoiseTables* tables)
+{
+    if (tables == defaultTables())
+        return;
+
+    lock();
+    const_cast<NoiseTables*>(tables)->holders--;
+    unlock();
+}
+
+const NoiseTables* NoiseRegistry::defaultTables()
+{
+    static const NoiseTables* tables = [] {
+        static NoiseTables defaults;
+        new (defaults.noiseStorage) OpenSimplexNoise::Noise();
+        defaults.built = true;
+        defaults.ready.store(true, std::memory_order_release);
+        return &defaults;
+    }();
+    return tables;
+}
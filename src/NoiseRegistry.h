@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "OpenSimplexNoise/OpenSimplexNoise.h"
+#include "SimdNoise.h"
+
+// Scalar and four-lane noise tables for one seed. Immutable while anyone holds them.
+struct NoiseTables {
+    NoiseTables() = default;
+    NoiseTables(const NoiseTables&) = delete;
+    NoiseTables& operator=(const NoiseTables&) = delete;
+
+    const OpenSimplexNoise::Noise* noise() const
+    {
+        return reinterpret_cast<const OpenSimplexNoise::Noise*>(noiseStorage);
+    }
+
+    const SimdNoise* simdNoise() const
+    {
+        return &simd;
+    }
+
+private:
+    friend class NoiseRegistry;
+
+    void build(int64_t newSeed);
+    void destroy();
+
+    alignas(OpenSimplexNoise::Noise) unsigned char noiseStorage[sizeof(OpenSimplexNoise::Noise)];
+    SimdNoise simd;
+
+    // Only touched by the module building the tables, or once nobody holds them.
+    bool built = false;
+    std::atomic<bool> ready{false};
+
+    // Guarded by the registry lock. An assigned entry has its seed, but may
+    // not be ready yet.
+    int64_t seed = 0;
+    int holders = 0;
+    bool assigned = false;
+};
+
+// Process-wide pool of noise tables keyed by seed. Every module of a chain gets
+// the same seed from Omen, so the whole chain shares one set of tables instead
+// of each module building its own.
+//
+// acquire() and release() never allocate and may be called from any engine
+// thread. Tables are built outside the lock by the caller that first asks for
+// their seed, so other seeds are never held up by the build; callers that ask
+// for the same seed meanwhile wait for it, which keeps every module's decisions
+// after a seed change on the new seed. The pool only grows in addUser(), which
+// runs when a module is created, and always keeps one entry per user. Each
+// user holds at most one table and releases it before acquiring the next, so
+// acquire() always finds a matching or free entry.
+class NoiseRegistry {
+public:
+    static NoiseRegistry& instance();
+
+    ~NoiseRegistry();
+
+    void addUser();
+    void removeUser();
+
+    // Tables for seed, built here if no entry has them yet, or waited for if
+    // another thread is building them. Release when done.
+    const NoiseTables* acquire(int64_t seed);
+    // Tables are cached after the last release so a seed that comes back is not rebuilt.
+    void release(const NoiseTables* tables);
+
+    // Tables of a default-constructed OpenSimplexNoise::Noise; need not be released.
+    static const NoiseTables* defaultTables();
+
+private:
+    static constexpr int CHUNK_SIZE = 16;
+
+    struct Chunk {
+        NoiseTables entries[CHUNK_SIZE];
+        Chunk* next = nullptr;
+    };
+
+    NoiseRegistry() = default;
+
+    void lock();
+    void unlock();
+
+    std::atomic_flag spinLock = ATOMIC_FLAG_INIT;
+    Chunk* chunks = nullptr;
+    int capacity = 0;
+    int users = 0;
+};
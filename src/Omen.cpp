@@ -1,5 +1,8 @@
+#include <atomic>
+
 #include "plugin.hpp"
 #include "DaisyExpander.h"
+#include "TempoTracker.h"
 
 constexpr int NUM_SEED_PARAMS = 6;
 
@@ -19,7 +22,7 @@ SeedState& operator++(SeedState& state) {
 }
 
 
-struct Omen final : Module {
+struct Omen final : Module, ChainHead {
 	enum ParamId {
 		ALPHA_PARAM,
 		BETA_PARAM,
@@ -57,6 +60,22 @@ struct Omen final : Module {
 	dsp::SchmittTrigger clockTrigger;
 	dsp::SchmittTrigger resetTrigger;
 
+	TempoTracker tempo;
+	float lastClockVoltage = 0.f;
+	// For the context menu; the tracker itself belongs to whichever thread publishes.
+	std::atomic<float> displayedSamplesPerTick{0.f};
+	std::atomic<float> sampleRate{44100.f};
+
+	// Last frame publish() ran for; it only detects once per frame.
+	std::atomic<int64_t> publishedFrame{-1};
+	std::atomic_flag publishLock = ATOMIC_FLAG_INIT;
+
+#ifdef TYCHE_STATS
+	ModuleStats stats;
+	// Next event to count; publish() may have queued it on a member's thread.
+	uint64_t statsCursor = 0;
+#endif
+
 	Omen() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 		configButton(ALPHA_PARAM, "Alpha");
@@ -67,9 +86,63 @@ struct Omen final : Module {
 		configButton(ZETA_PARAM, "Zeta");
 		configInput(CLOCK_INPUT, "Clock (24ppqn)");
 		configInput(RESET_INPUT, "Reset");
+
+		sameSampleDelivery = true;
 	}
 
 	void process(const ProcessArgs& args) override {
+		TYCHE_STATS_PROCESS(args);
+		sampleRate.store(args.sampleRate, std::memory_order_relaxed);
+		publish(args.frame);
+
+		updateSeedButtonColors(args.sampleTime);
+
+#ifdef TYCHE_STATS
+		countEvents();
+#endif
+	}
+
+#ifdef TYCHE_STATS
+	void countEvents()
+	{
+		const uint64_t end = events.end();
+		for (statsCursor = std::max(statsCursor, events.begin()); statsCursor < end; statsCursor++)
+		{
+			stats.countEvents(1);
+			if (events.at(statsCursor).type == ChainEventType::SEED)
+				stats.countReseed();
+		}
+	}
+#endif
+
+	void publish(const int64_t frame) override
+	{
+		// A bypassed Omen stops the chain.
+		if (isBypassed())
+			return;
+
+		// Members may ask from several engine threads; all but the first one of a
+		// frame only take the fast path.
+		if (publishedFrame.load(std::memory_order_acquire) == frame)
+			return;
+
+		while (publishLock.test_and_set(std::memory_order_acquire)) {}
+
+		if (publishedFrame.load(std::memory_order_relaxed) != frame) {
+			detect(frame);
+			publishedFrame.store(frame, std::memory_order_release);
+		}
+
+		publishLock.clear(std::memory_order_release);
+	}
+
+	void onExpanderChange(const ExpanderChangeEvent& e) override
+	{
+		updateChainHead(this);
+	}
+
+	void detect(const int64_t frame)
+	{
 		bool seedChanged = false;
 		for (int i = 0; i < NUM_SEED_PARAMS; i++)
 		{
@@ -83,17 +156,55 @@ struct Omen final : Module {
 		if (seedChanged)
 			updateSeed();
 
-		const bool clockHigh = clockTrigger.process(inputs[CLOCK_INPUT].getVoltage());
+		const float clockVoltage = inputs[CLOCK_INPUT].getVoltage();
+		const bool clockHigh = clockTrigger.process(clockVoltage);
 		if (clockHigh)
+		{
 			clock++;
+			tempo.tick(edgeTime(frame, clockVoltage));
+			displayedSamplesPerTick.store(static_cast<float>(tempo.getPeriod()), std::memory_order_relaxed);
+		}
+		lastClockVoltage = clockVoltage;
 
 		const bool resetHigh = resetTrigger.process(inputs[RESET_INPUT].getVoltage());
 		if (resetHigh)
 			reset();
 
-		propagateToDaisyChained(clockHigh, resetHigh, seedChanged);
+		// The seed also changes on randomize and patch load, so compare rather
+		// than rely on seedChanged.
+		ChainEvent event;
+		event.frame = frame;
 
-		updateSeedButtonColors(args.sampleTime);
+		if (seed != publishedSeed.load(std::memory_order_relaxed)) {
+			publishedSeed.store(seed, std::memory_order_relaxed);
+			event.type = ChainEventType::SEED;
+			event.seed = seed;
+			events.push(event);
+		}
+
+		if (resetHigh) {
+			event.type = ChainEventType::RESET;
+			events.push(event);
+		}
+
+		if (clockHigh) {
+			event.type = ChainEventType::CLOCK;
+			event.clock = clock;
+			event.tickTime = tempo.getTickTime();
+			event.samplesPerTick = static_cast<float>(tempo.getPeriod());
+			events.push(event);
+		}
+	}
+
+	// Where between the previous frame and this one the clock crossed the
+	// trigger threshold, so the tempo does not jitter by whole samples.
+	double edgeTime(const int64_t frame, const float clockVoltage) const
+	{
+		if (clockVoltage <= lastClockVoltage)
+			return static_cast<double>(frame);
+
+		const float fraction = clamp((1.f - lastClockVoltage) / (clockVoltage - lastClockVoltage), 0.f, 1.f);
+		return static_cast<double>(frame - 1) + fraction;
 	}
 
 	void onReset(const ResetEvent& e) override
@@ -108,32 +219,6 @@ struct Omen final : Module {
 			seedState = static_cast<SeedState>(random::u32() % 6);
 
 		updateSeed();
-
-		propagateToDaisyChained(false, false, true);
-	}
-
-	void propagateToDaisyChained(const bool clockHigh, const bool resetHigh, const bool seedChanged)
-	{
-		Module* rightModule = getRightExpander().module;
-		if (!isExpanderCompatible(rightModule))
-			return;
-
-		// ReSharper disable once CppReinterpretCastFromVoidPtr
-		auto* producerMessage = reinterpret_cast<Message*>(rightModule->getLeftExpander().producerMessage);
-		if (!producerMessage)
-			return;
-
-		// TODO: Message should be a struct with a proper constructor.
-		Message message;
-		message.seed = seed;
-		message.seedChanged = seedChanged;
-		message.clock = clock;
-		message.clockReceived = clockHigh;
-		message.globalReset = resetHigh;
-
-		*producerMessage = message;
-
-		rightModule->getLeftExpander().requestMessageFlip();
 	}
 
 	bool isSeedButtonPushed(const int btnIndex)
@@ -211,6 +296,8 @@ struct Omen final : Module {
 		}
 		json_object_set_new(rootJ, "seedConfiguration", seedConfigurationJ);
 
+		json_object_set_new(rootJ, "sameSampleDelivery", json_boolean(sameSampleDelivery));
+
 		return rootJ;
 	}
 
@@ -233,7 +320,10 @@ struct Omen final : Module {
 			}
 		}
 
-		propagateToDaisyChained(false, false, true);
+		// Patches saved before the option existed keep the one-module-per-sample delivery.
+		const json_t* sameSampleDeliveryJ = json_object_get(rootJ, "sameSampleDelivery");
+		sameSampleDelivery = sameSampleDeliveryJ && json_boolean_value(sameSampleDeliveryJ);
+
 	}
 };
 
@@ -253,6 +343,26 @@ struct OmenWidget final : ModuleWidget {
 		addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(7.647, 96.5)), module, Omen::CLOCK_INPUT));
 		addInput(createInputCentered<DarkPJ301MPort>(mm2px(Vec(7.62, 114.0)), module, Omen::RESET_INPUT));
 	}
+
+	void appendContextMenu(ui::Menu* menu) override
+	{
+		Omen* module = getModule<Omen>();
+
+		menu->addChild(new MenuSeparator());
+		menu->addChild(createBoolPtrMenuItem("Same-sample delivery", "", &module->sameSampleDelivery));
+		menu->addChild(createMenuLabel("Chain length: " + std::to_string(module->chainLength)));
+
+		const float samplesPerTick = module->displayedSamplesPerTick.load(std::memory_order_relaxed);
+		const float sampleRate = module->sampleRate.load(std::memory_order_relaxed);
+		if (samplesPerTick > 0.f)
+			menu->addChild(createMenuLabel(string::f("Tempo: %.1f BPM", sampleRate * 60.f / (24.f * samplesPerTick))));
+		else
+			menu->addChild(createMenuLabel("Tempo: no clock"));
+
+#ifdef TYCHE_STATS
+		appendStatsMenu(menu, module->stats);
+#endif
+	}
 };
 
 
@@ -0,0 +1,146 @@
+#include "SimdNoise.h"
+
+namespace {
+
+constexpr double STRETCH_2D = -0.211324865405187; // (1 / sqrt(2 + 1) - 1) / 2
+constexpr double SQUISH_2D = 0.366025403784439;   // (sqrt(2 + 1) - 1) / 2
+constexpr float NORM_2D = 47.f;
+
+constexpr float GRADIENTS_2D[16] = {
+    5.f, 2.f, 2.f, 5.f, -5.f, 2.f, -2.f, 5.f,
+    5.f, -2.f, 2.f, -5.f, -5.f, -2.f, -2.f, -5.f,
+};
+
+int fastFloor(const double x)
+{
+    const int xi = static_cast<int>(x);
+    return x < xi ? xi - 1 : xi;
+}
+
+}
+
+SimdNoise::SimdNoise() = default;
+
+SimdNoise::SimdNoise(const int64_t seed)
+{
+    reseed(seed);
+}
+
+void SimdNoise::reseed(const int64_t seed)
+{
+    // Same LCG and Fisher-Yates shuffle as OpenSimplexNoise::Noise(int64_t),
+    // done in unsigned arithmetic to get its wrap-around without the UB.
+    uint8_t source[256];
+    for (int i = 0; i < 256; i++)
+        source[i] = static_cast<uint8_t>(i);
+
+    uint64_t state = static_cast<uint64_t>(seed);
+    for (int i = 0; i < 3; i++)
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    for (int i = 255; i >= 0; i--) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        int r = static_cast<int>(static_cast<int64_t>(state + 31) % (i + 1));
+        if (r < 0)
+            r += i + 1;
+
+        perm[i] = source[r];
+        permGradIndex2D[i] = perm[i] & 0x0E;
+        source[r] = source[i];
+    }
+}
+
+float_4 SimdNoise::eval(const double x, const double* y) const
+{
+    const double xs[4] = {x, x, x, x};
+    return eval(xs, y);
+}
+
+float_4 SimdNoise::eval(const double* x, const double* y) const
+{
+    // 1. Locate each lane's lattice cell in double precision.
+    int32_t xsb[4], ysb[4];
+    float dx0Lanes[4], dy0Lanes[4], xinsLanes[4], yinsLanes[4];
+
+    for (int lane = 0; lane < 4; lane++) {
+        const double stretchOffset = (x[lane] + y[lane]) * STRETCH_2D;
+        const double xs = x[lane] + stretchOffset;
+        const double ys = y[lane] + stretchOffset;
+
+        xsb[lane] = fastFloor(xs);
+        ysb[lane] = fastFloor(ys);
+
+        const double squishOffset = (xsb[lane] + ysb[lane]) * SQUISH_2D;
+        dx0Lanes[lane] = static_cast<float>(x[lane] - (xsb[lane] + squishOffset));
+        dy0Lanes[lane] = static_cast<float>(y[lane] - (ysb[lane] + squishOffset));
+        xinsLanes[lane] = static_cast<float>(xs - xsb[lane]);
+        yinsLanes[lane] = static_cast<float>(ys - ysb[lane]);
+    }
+
+    // 2. Pick the (0,0)/(1,1) vertex and the extra vertex for all lanes at once.
+    const float_4 squish = static_cast<float>(SQUISH_2D);
+    const float_4 dx0(dx0Lanes[0], dx0Lanes[1], dx0Lanes[2], dx0Lanes[3]);
+    const float_4 dy0(dy0Lanes[0], dy0Lanes[1], dy0Lanes[2], dy0Lanes[3]);
+    const float_4 xins(xinsLanes[0], xinsLanes[1], xinsLanes[2], xinsLanes[3]);
+    const float_4 yins(yinsLanes[0], yinsLanes[1], yinsLanes[2], yinsLanes[3]);
+    const float_4 inSum = xins + yins;
+
+    const float_4 upper = inSum > 1.f;
+    const float_4 xAhead = xins > yins;
+
+    const float_4 lowerZins = 1.f - inSum;
+    const float_4 lowerNearOrigin = (lowerZins > xins) | (lowerZins > yins);
+    const float_4 upperZins = 2.f - inSum;
+    const float_4 upperNearOrigin = (upperZins < xins) | (upperZins < yins);
+
+    const float_4 lowerExtX = ifelse(lowerNearOrigin, ifelse(xAhead, 1.f, -1.f), 1.f);
+    const float_4 lowerExtY = ifelse(lowerNearOrigin, ifelse(xAhead, -1.f, 1.f), 1.f);
+    const float_4 upperExtX = ifelse(upperNearOrigin, ifelse(xAhead, 2.f, 0.f), 0.f);
+    const float_4 upperExtY = ifelse(upperNearOrigin, ifelse(xAhead, 0.f, 2.f), 0.f);
+
+    const float_4 extX = ifelse(upper, upperExtX, lowerExtX);
+    const float_4 extY = ifelse(upper, upperExtY, lowerExtY);
+    const float_4 baseOffset = ifelse(upper, 1.f, 0.f);
+
+    // Displacement from a vertex at lattice offset (i, j) is d0 - (i, j) - (i + j) * squish.
+    const float_4 dxExt = dx0 - extX - (extX + extY) * squish;
+    const float_4 dyExt = dy0 - extY - (extX + extY) * squish;
+    const float_4 dxBase = dx0 - baseOffset - 2.f * baseOffset * squish;
+    const float_4 dyBase = dy0 - baseOffset - 2.f * baseOffset * squish;
+    const float_4 dx1 = dx0 - 1.f - squish;
+    const float_4 dy1 = dy0 - squish;
+    const float_4 dx2 = dx0 - squish;
+    const float_4 dy2 = dy0 - 1.f - squish;
+
+    // 3. Gradient lookups; SSE has no gather, so these stay per lane.
+    int32_t extXLanes[4], extYLanes[4], baseLanes[4];
+    simd::int32_4(extX).store(extXLanes);
+    simd::int32_4(extY).store(extYLanes);
+    simd::int32_4(baseOffset).store(baseLanes);
+
+    int index[4][4];
+    for (int lane = 0; lane < 4; lane++) {
+        index[0][lane] = gradientIndex(xsb[lane] + 1, ysb[lane]);
+        index[1][lane] = gradientIndex(xsb[lane], ysb[lane] + 1);
+        index[2][lane] = gradientIndex(xsb[lane] + baseLanes[lane], ysb[lane] + baseLanes[lane]);
+        index[3][lane] = gradientIndex(xsb[lane] + extXLanes[lane], ysb[lane] + extYLanes[lane]);
+    }
+
+    // 4. Attenuated gradient contributions, in the scalar version's summation order.
+    const auto contribution = [&index](const int vertex, const float_4 dx, const float_4 dy) {
+        const int* i = index[vertex];
+        const float_4 gx(GRADIENTS_2D[i[0]], GRADIENTS_2D[i[1]], GRADIENTS_2D[i[2]], GRADIENTS_2D[i[3]]);
+        const float_4 gy(GRADIENTS_2D[i[0] + 1], GRADIENTS_2D[i[1] + 1], GRADIENTS_2D[i[2] + 1], GRADIENTS_2D[i[3] + 1]);
+
+        float_4 attn = simd::fmax(2.f - dx * dx - dy * dy, 0.f);
+        attn *= attn;
+        return attn * attn * (gx * dx + gy * dy);
+    };
+
+    float_4 value = contribution(0, dx1, dy1);
+    value += contribution(1, dx2, dy2);
+    value += contribution(2, dxBase, dyBase);
+    value += contribution(3, dxExt, dyExt);
+
+    return value / NORM_2D;
+}
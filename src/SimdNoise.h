@@ -0,0 +1,36 @@
+#pragma once
+
+#include "plugin.hpp"
+
+using simd::float_4;
+
+// Four-lane OpenSimplex 2D evaluator.
+//
+// Builds the same permutation table as OpenSimplexNoise::Noise for a given seed
+// and evaluates four (x, y) points per call. Lattice selection runs in double
+// precision, so large coordinates (e.g. a phase that has been growing for
+// hours) are located exactly; the kernel itself runs in single precision.
+// For equal seeds and coordinates the result stays within TOLERANCE of the
+// scalar double-precision eval() (measured worst case is about 6e-7).
+struct SimdNoise {
+    static constexpr float TOLERANCE = 1e-5f;
+
+    SimdNoise();
+    explicit SimdNoise(int64_t seed);
+
+    void reseed(int64_t seed);
+
+    float_4 eval(const double* x, const double* y) const;
+    float_4 eval(double x, const double* y) const;
+
+private:
+    int gradientIndex(const int32_t xsv, const int32_t ysv) const
+    {
+        return permGradIndex2D[(perm[xsv & 0xFF] + ysv) & 0xFF];
+    }
+
+    // Zeroed until reseeded, matching a default-constructed OpenSimplexNoise::Noise.
+    uint8_t perm[256] = {};
+    // perm[i] & 0x0E, the offset of the 2D gradient picked by lattice point i.
+    uint8_t permGradIndex2D[256] = {};
+};
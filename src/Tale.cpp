@@ -1,4 +1,5 @@
 #include "DaisyExpander.h"
+#include "LoopTable.h"
 #include "plugin.hpp"
 
 
@@ -23,16 +24,38 @@ struct Tale final : DaisyExpander {
 		LIGHTS_LEN
 	};
 
-	double phase = 0;
+	// Poly channels read the noise plane at x = variant + c * CHANNEL_SPREAD, far
+	// enough apart that no two channels or variants share a walk.
+	static constexpr float CHANNEL_SPREAD = 256.f;
+
+	// Audio mode evaluates four sub-samples per sample, one per SIMD lane, and
+	// decimates them four channels at a time.
+	static constexpr int AUDIO_OVERSAMPLE = 4;
+	static constexpr int AUDIO_DECIMATOR_QUALITY = 8;
+
+	double phases[PORT_MAX_CHANNELS] = {};
 	float variant = 1.f;
 
 	dsp::SchmittTrigger resetTrigger;
-	dsp::SchmittTrigger sampleAndHoldTrigger;
+	dsp::SchmittTrigger sampleAndHoldTriggers[PORT_MAX_CHANNELS];
 
 	const float minSpeed = 0.001f;
 	const float maxSpeed = dsp::FREQ_A4;
+	// Audio mode: eight octaves around A4, A0 to A8.
+	const float minAudioSpeed = dsp::FREQ_A4 / 16.f;
+	const float maxAudioSpeed = dsp::FREQ_A4 * 16.f;
+
+	float heldNoiseValues[PORT_MAX_CHANNELS] = {};
 
-	float heldNoiseValue = 0.f;
+	bool audioMode = false;
+	dsp::Decimator<AUDIO_OVERSAMPLE, AUDIO_DECIMATOR_QUALITY, float_4> audioDecimators[PORT_MAX_CHANNELS / 4];
+
+	// Loop length in noise units, 0 for a walk that never repeats. Looping
+	// channels play a table rendered in the background and keep their phase
+	// within the loop.
+	const std::array<int, 8> loopLengths = {0, 1, 2, 4, 8, 16, 32, 64};
+	int loopLengthIdx = 0;
+	LoopTableRenderer loopRenderer{CHANNEL_SPREAD};
 
 	dsp::ClockDivider variantChangeDivider;
 	dsp::ClockDivider lightDivider;
@@ -47,6 +70,7 @@ struct Tale final : DaisyExpander {
 		configOutput(OUT_OUTPUT, "Main");
 
 		variantChangeDivider.setDivision(16384);
+		lightDivider.setDivision(64);
 	}
 
 	bool firstEverProcess = true;
@@ -54,6 +78,7 @@ struct Tale final : DaisyExpander {
 	int seed = 0;
 
 	void process(const ProcessArgs& args) override {
+		TYCHE_STATS_PROCESS(args);
 		DaisyExpander::process(args);
 
 		if (resetTrigger.process(getInput(RESET_INPUT).getVoltage()))
@@ -63,31 +88,178 @@ struct Tale final : DaisyExpander {
 		if (variant != newVariant && variantChangeDivider.process())
 			variant = newVariant;
 
-		float outCV = heldNoiseValue;
-		if (getInput(SAMPLE_AND_HOLD_INPUT).isConnected())
+		const int channels = std::max({1, getInput(PACE_INPUT).getChannels(), getInput(SAMPLE_AND_HOLD_INPUT).getChannels()});
+		getOutput(OUT_OUTPUT).setChannels(channels);
+
+		// Continuous channels take a fresh value every sample, S&H channels only when triggered.
+		bool due[PORT_MAX_CHANNELS] = {};
+		const bool sampleAndHold = getInput(SAMPLE_AND_HOLD_INPUT).isConnected();
+		for (int c = 0; c < channels; c++)
+		{
+			due[c] = !sampleAndHold || sampleAndHoldTriggers[c].process(getInput(SAMPLE_AND_HOLD_INPUT).getPolyVoltage(c));
+		}
+
+		float speeds[PORT_MAX_CHANNELS];
+		computeSpeeds(channels, speeds);
+
+		// A table played at audio paces would alias, so audio mode wins over the
+		// loop; the loop length comes back when audio mode is turned off.
+		const int loopLength = audioMode ? 0 : loopLengths[loopLengthIdx];
+		const LoopTable* loopTable = loopLength > 0 ? getLoopTable(loopLength, channels) : nullptr;
+
+		float noiseValues[PORT_MAX_CHANNELS];
+		if (loopTable)
+			sampleLoop(*loopTable, channels, due, noiseValues);
+		else if (audioMode && !sampleAndHold)
+			sampleNoiseOversampled(channels, speeds, args.sampleTime, noiseValues);
+		else
+			sampleNoise(channels, due, noiseValues);
+
+		for (int c = 0; c < channels; c++)
 		{
-			if (sampleAndHoldTrigger.process(getInput(SAMPLE_AND_HOLD_INPUT).getVoltage()))
+			float outCV = heldNoiseValues[c];
+			if (!sampleAndHold)
+				outCV = noiseValues[c];
+			else if (due[c])
+				heldNoiseValues[c] = outCV = noiseValues[c];
+
+			getOutput(OUT_OUTPUT).setVoltage(rescale(outCV, -1.f, 1.f, -5.f, 5.f), c);
+		}
+
+		for (int c = 0; c < channels; c++)
+			phases[c] += speeds[c] * args.sampleTime;
+
+		// Wrapping keeps looping phases small, so they never lose precision.
+		if (loopLength > 0)
+		{
+			for (int c = 0; c < channels; c++)
 			{
-				heldNoiseValue = outCV = noise->eval(variant, phase);
+				if (phases[c] >= loopLength)
+					phases[c] = std::fmod(phases[c], static_cast<double>(loopLength));
 			}
-		} else
+		}
+
+		if (lightDivider.process())
+			setLight(PACE_LIGHT, getOutput(OUT_OUTPUT).getVoltage(0), args.sampleTime * lightDivider.getDivision());
+	}
+
+	// Fills out[c] for every due channel. A mono Tale keeps the scalar
+	// evaluation; poly channels are evaluated four at a time.
+	void sampleNoise(const int channels, const bool* due, float* out) const
+	{
+		if (channels == 1)
 		{
-			outCV = noise->eval(variant, phase);
+			if (due[0])
+			{
+				TYCHE_STATS_COUNT(countNoise(1));
+				out[0] = static_cast<float>(noise->eval(variant, phases[0]));
+			}
+			return;
 		}
 
-		outCV = rescale(outCV, -1.f, 1.f, -5.f, 5.f);
-		getOutput(OUT_OUTPUT).setVoltage(outCV);
+		for (int c = 0; c < channels; c += 4)
+		{
+			if (!(due[c] || due[c + 1] || due[c + 2] || due[c + 3]))
+				continue;
+
+			double x[4];
+			for (int i = 0; i < 4; i++)
+				x[i] = variant + static_cast<float>(c + i) * CHANNEL_SPREAD;
 
-		float pace = getParam(PACE_PARAM).getValue();
-		if (getInput(PACE_INPUT).isConnected())
-			pace *= rescale(getInput(PACE_INPUT).getVoltage(), -5.f, 5.f, 0.f, 1.f);
+			TYCHE_STATS_COUNT(countNoise(4));
+			const float_4 values = simdNoise->eval(x, &phases[c]);
+			values.store(&out[c]);
+		}
+	}
 
-		const float speed = minSpeed * std::pow(maxSpeed / minSpeed, pace);
-		phase += speed * args.sampleTime;
+	// The table for the current seed, variant and loop length, asking for a new
+	// one when any of them changed. Until it is ready the live walk is played,
+	// which is the same as the table except for the fade at the end of the loop.
+	const LoopTable* getLoopTable(const int loopLength, const int channels)
+	{
+		LoopTable::Key key;
+		key.seed = seed;
+		key.seeded = isSeeded();
+		key.variant = variant;
+		key.length = loopLength;
+		key.channels = channels;
+		loopRenderer.request(key);
+
+		const LoopTable* table = loopRenderer.table();
+		if (!table || table->key.seed != key.seed || table->key.seeded != key.seeded || table->key.variant != variant || table->key.length != loopLength || table->key.channels < channels)
+			return nullptr;
+		return table;
+	}
 
-		if (lightDivider.process())
-			setLight(PACE_LIGHT, outCV, args.sampleTime);
-}
+	void sampleLoop(const LoopTable& table, const int channels, const bool* due, float* out)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			if (due[c])
+				out[c] = table.read(c, phases[c]);
+		}
+	}
+
+	// Band-limited version of sampleNoise() for audio rates. Each channel's walk
+	// is evaluated at AUDIO_OVERSAMPLE points across the coming sample and run
+	// through a decimation filter, so fast paces do not alias.
+	void sampleNoiseOversampled(const int channels, const float* speeds, const float sampleTime, float* out)
+	{
+		for (int c = 0; c < channels; c += 4)
+		{
+			// Row i holds the sub-samples of channel c + i.
+			float_4 subSamples[AUDIO_OVERSAMPLE];
+			for (int i = 0; i < 4; i++)
+			{
+				if (c + i >= channels)
+				{
+					subSamples[i] = 0.f;
+					continue;
+				}
+
+				const double phase = phases[c + i];
+				const double step = speeds[c + i] * sampleTime / AUDIO_OVERSAMPLE;
+				const double y[AUDIO_OVERSAMPLE] = {phase, phase + step, phase + 2 * step, phase + 3 * step};
+				TYCHE_STATS_COUNT(countNoise(AUDIO_OVERSAMPLE));
+				subSamples[i] = simdNoise->eval(variant + static_cast<float>(c + i) * CHANNEL_SPREAD, y);
+			}
+
+			// Now row k holds sub-sample k of the four channels.
+			_MM_TRANSPOSE4_PS(subSamples[0].v, subSamples[1].v, subSamples[2].v, subSamples[3].v);
+
+			const float_4 values = audioDecimators[c / 4].process(subSamples);
+			values.store(&out[c]);
+		}
+	}
+
+	void computeSpeeds(const int channels, float* speeds)
+	{
+		const bool paceConnected = getInput(PACE_INPUT).isConnected();
+		const float paceParam = getParam(PACE_PARAM).getValue();
+		const float lowest = audioMode ? minAudioSpeed : minSpeed;
+		const float highest = audioMode ? maxAudioSpeed : maxSpeed;
+
+		if (channels == 1)
+		{
+			float pace = paceParam;
+			if (paceConnected)
+				pace *= rescale(getInput(PACE_INPUT).getVoltage(), -5.f, 5.f, 0.f, 1.f);
+
+			speeds[0] = lowest * std::pow(highest / lowest, pace);
+			return;
+		}
+
+		const float logSpeedRange = std::log(highest / lowest);
+		for (int c = 0; c < channels; c += 4)
+		{
+			float_4 pace = paceParam;
+			if (paceConnected)
+				pace *= (getInput(PACE_INPUT).getPolyVoltageSimd<float_4>(c) + 5.f) / 10.f;
+
+			const float_4 speed = lowest * simd::exp(pace * logSpeedRange);
+			speed.store(&speeds[c]);
+		}
+	}
 
 	void setLight(LightId lightId, float val, float delta)
 	{
@@ -114,7 +286,8 @@ struct Tale final : DaisyExpander {
 
 	void reset() override
 	{
-		phase = 0;
+		for (double& phase : phases)
+			phase = 0;
 	}
 
 	json_t* dataToJson() override
@@ -124,15 +297,30 @@ struct Tale final : DaisyExpander {
 		json_t* variantJ = json_real(variant);
 		json_object_set_new(rootJ, "variant", variantJ);
 
-		json_t* heldNoiseValueJ = json_real(heldNoiseValue);
+		json_t* heldNoiseValueJ = json_real(heldNoiseValues[0]);
 		json_object_set_new(rootJ, "heldNoiseValue", heldNoiseValueJ);
 
-		json_t* phaseJ = json_real(phase);
+		json_t* phaseJ = json_real(phases[0]);
 		json_object_set_new(rootJ, "phase", phaseJ);
 
+		json_t* heldNoiseValuesJ = json_array();
+		json_t* phasesJ = json_array();
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+		{
+			json_array_append_new(heldNoiseValuesJ, json_real(heldNoiseValues[c]));
+			json_array_append_new(phasesJ, json_real(phases[c]));
+		}
+		json_object_set_new(rootJ, "heldNoiseValues", heldNoiseValuesJ);
+		json_object_set_new(rootJ, "phases", phasesJ);
+
 		json_t* seedJ = json_integer(seed);
 		json_object_set_new(rootJ, "seed", seedJ);
 
+		json_object_set_new(rootJ, "audioMode", json_boolean(audioMode));
+
+		json_t* loopLengthIdxJ = json_integer(loopLengthIdx);
+		json_object_set_new(rootJ, "loopLengthIdx", loopLengthIdxJ);
+
 		return rootJ;
 	}
 
@@ -144,17 +332,39 @@ struct Tale final : DaisyExpander {
 
 		const json_t* heldNoiseValueJ = json_object_get(rootJ, "heldNoiseValue");
 		if (heldNoiseValueJ)
-			heldNoiseValue = static_cast<float>(json_real_value(heldNoiseValueJ));
+			heldNoiseValues[0] = static_cast<float>(json_real_value(heldNoiseValueJ));
 
 		const json_t* phaseJ = json_object_get(rootJ, "phase");
 		if (phaseJ)
-			phase = json_real_value(phaseJ);
+			phases[0] = json_real_value(phaseJ);
+
+		// Patches saved before poly support only carry channel 0.
+		const json_t* heldNoiseValuesJ = json_object_get(rootJ, "heldNoiseValues");
+		const json_t* phasesJ = json_object_get(rootJ, "phases");
+		for (int c = 1; c < PORT_MAX_CHANNELS; c++)
+		{
+			const json_t* heldJ = json_array_get(heldNoiseValuesJ, c);
+			if (heldJ)
+				heldNoiseValues[c] = static_cast<float>(json_real_value(heldJ));
+
+			const json_t* channelPhaseJ = json_array_get(phasesJ, c);
+			if (channelPhaseJ)
+				phases[c] = json_real_value(channelPhaseJ);
+		}
 
 		const json_t* seedJ = json_object_get(rootJ, "seed");
 		if (seedJ) {
 			seed = static_cast<int>(json_integer_value(seedJ));
 			reseedNoise(seed);
 		}
+
+		const json_t* audioModeJ = json_object_get(rootJ, "audioMode");
+		if (audioModeJ)
+			audioMode = json_boolean_value(audioModeJ);
+
+		const json_t* loopLengthIdxJ = json_object_get(rootJ, "loopLengthIdx");
+		if (loopLengthIdxJ)
+			loopLengthIdx = clamp(static_cast<int>(json_integer_value(loopLengthIdxJ)), 0, static_cast<int>(loopLengths.size()) - 1);
 	}
 };
 
@@ -180,6 +390,21 @@ struct TaleWidget final : ModuleWidget {
 
 		addOutput(createOutputCentered<DarkPJ301MPort>(mm2px(Vec(7.647, 96.5)), module, Tale::OUT_OUTPUT));
 	}
+
+	void appendContextMenu(ui::Menu* menu) override
+	{
+		Tale* module = getModule<Tale>();
+
+		menu->addChild(new MenuSeparator());
+		menu->addChild(createBoolPtrMenuItem("Audio mode (band-limited)", "", &module->audioMode));
+		ui::MenuItem* loopLengthItem = createIndexPtrSubmenuItem("Loop length", {"Off", "1", "2", "4", "8", "16", "32", "64"}, &module->loopLengthIdx);
+		loopLengthItem->disabled = module->audioMode;
+		menu->addChild(loopLengthItem);
+
+#ifdef TYCHE_STATS
+		appendStatsMenu(menu, module->stats);
+#endif
+	}
 };
 
 
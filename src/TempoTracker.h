@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cmath>
+
+// Follows the tempo of a 24ppqn clock with a second-order delay-locked loop.
+// Every edge is compared with the time the loop predicted for it; the error
+// nudges both the prediction and the period, so a jittery clock yields a
+// steady tempo and tick times that lie on a smooth grid, while tempo ramps are followed within a few beats.
+//
+// Times are in engine frames and may be fractional, so an edge can be placed
+// between two samples.
+class TempoTracker {
+public:
+    // Loop bandwidth in cycles per tick.
+    static constexpr double BANDWIDTH = 0.02;
+
+    // Adds the clock edge at time.
+    void tick(const double time)
+    {
+        // The first edge, or the first after the clock stopped for more than
+        // two ticks, only gives a time to measure the next interval from.
+        if (edges == 0 || (edges == 2 && time - lastEdge > 2.0 * period)) {
+            edges = 1;
+            lastEdge = time;
+            tickTime = time;
+            return;
+        }
+
+        const double interval = time - lastEdge;
+        lastEdge = time;
+
+        // Second edge, or a jump in tempo the loop would take too long to
+        // follow: start over from the measured interval.
+        const double error = time - next;
+        if (edges == 1 || std::fabs(error) > 0.5 * period) {
+            edges = 2;
+            period = interval;
+            tickTime = time;
+            next = time + period;
+            return;
+        }
+
+        const double omega = 2.0 * M_PI * BANDWIDTH;
+        tickTime = next;
+        next += std::sqrt(2.0) * omega * error + period;
+        period += omega * omega * error;
+    }
+
+    bool isLocked() const
+    {
+        return edges == 2;
+    }
+
+    // Frames per tick; 0 until two edges have been seen.
+    double getPeriod() const
+    {
+        return isLocked() ? period : 0.0;
+    }
+
+    // Smoothed time of the last edge.
+    double getTickTime() const
+    {
+        return tickTime;
+    }
+
+private:
+    int edges = 0;
+    double lastEdge = 0.0;
+    double tickTime = 0.0;
+    double next = 0.0;
+    double period = 0.0;
+};
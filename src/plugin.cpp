@@ -12,4 +12,7 @@ void init(Plugin* p) {
 	p->addModel(modelFate);
 	p->addModel(modelBlank);
 	p->addModel(modelMoira);
+	p->addModel(modelHorae);
+	p->addModel(modelLachesis);
+	p->addModel(modelClotho);
 }
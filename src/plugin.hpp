@@ -11,3 +11,6 @@ extern Model* modelBlank;
 extern Model* modelTale;
 extern Model* modelFate;
 extern Model* modelMoira;
+extern Model* modelHorae;
+extern Model* modelLachesis;
+extern Model* modelClotho;